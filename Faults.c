@@ -0,0 +1,89 @@
+/**
+ * @file Faults.c
+ * @brief Table driven fault detection with debouncing and hysteresis.
+ *
+ * Each entry of FaultLimits watches one float signal against a trip level
+ * and a clear level.  Every ISR pass over the trip level integrates a
+ * counter, a pass beyond the clear level dumps it back to zero, and in
+ * between the counter holds.  FaultConfirmed() is called only when the
+ * counter reaches the limit, so a single spike no longer trips F_OVERVOLT
+ * or F_OVERTEMP, and the reaction of the class follows at once since the
+ * counter has already done the debouncing of FaultDebounce.  A confirmed
+ * entry stays latched until its signal returns beyond the clear level.
+ *
+ * A high limit has Trip above Clear, a low limit (undervoltage) has Trip
+ * below Clear.  AddFaultLimit folds the direction into Sign so UpdateFaults
+ * runs the same compare for both.  Configuration and counters are kept in
+ * separate arrays, the loop reads the table in order once per ISR.
+ *
+ * This code is for TI 28335 DSP.  Adapt it for other platforms.
+ */
+
+#include "Setup.h"     // DSP2833x Headerfile Include File
+
+FaultLimit FaultLimits[FAULT_LIMITS];	/**< Fault detect, limit table, filled by AddFaultLimit */
+int FaultLimitCount = 0;				/**< Fault detect, entries in use */
+int FaultLimitCounter[FAULT_LIMITS];	/**< Fault detect, integrate and dump counters */
+int FaultLimitLatch[FAULT_LIMITS];		/**< Fault detect, 1 once confirmed until cleared */
+
+/** Add a limit to the table, returns its index or -1 when full.
+ *  trip and clear are in signal units, limit is ISR passes over trip */
+int AddFaultLimit(float *signal, float trip, float clear, int limit, int code){
+
+	FaultLimit *f;
+	int i;
+
+	if(FaultLimitCount>=FAULT_LIMITS) return -1;
+
+	i = FaultLimitCount;
+	f = &FaultLimits[i];
+	f->Signal = signal;
+	f->Sign = (trip>=clear) ? 1.0 : -1.0;
+	f->Trip = f->Sign * trip;
+	f->Clear = f->Sign * clear;
+	f->Limit = (limit<1) ? 1 : limit;
+	f->Code = code;
+	FaultLimitCounter[i] = 0;
+	FaultLimitLatch[i] = 0;
+	FaultLimitCount++;
+	return i;
+}
+
+/** Clear the counters and latches so faults can re-assert, ResetFaults calls it */
+void ResetFaultLimits(void){
+
+	int i;
+
+	for(i=0;i<FAULT_LIMITS;i++){
+		FaultLimitCounter[i] = 0;
+		FaultLimitLatch[i] = 0;
+	}
+}
+
+/** Evaluate every limit once, call from the main ISR */
+#pragma CODE_SECTION(UpdateFaults, "ramfuncs")
+void UpdateFaults(void){
+
+	const FaultLimit *f = FaultLimits;
+	float v;
+	int i;
+	int n;
+
+	for(i=0;i<FaultLimitCount;i++,f++){
+		v = f->Sign * *(f->Signal);
+		n = FaultLimitCounter[i];
+		if(v>f->Trip){
+			// Integrate towards the limit
+			if(n<f->Limit) n++;
+			if(n>=f->Limit && FaultLimitLatch[i]==0){
+				FaultLimitLatch[i] = 1;
+				FaultConfirmed(f->Code,*(f->Signal));
+			}
+		}else if(v<f->Clear){
+			// Dump and re-arm
+			n = 0;
+			FaultLimitLatch[i] = 0;
+		}
+		FaultLimitCounter[i] = n;
+	}
+}
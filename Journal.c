@@ -0,0 +1,284 @@
+/**
+ * @file Journal.c
+ * @brief Non-volatile journal of the event log.
+ *
+ * The event log lives in RAM and is lost on a watchdog reset or brown-out.
+ * The journal appends each event record to flash or FRAM from the background
+ * loop and rebuilds the most recent JOURNAL_RESTORE events at startup.
+ *
+ * The store is log-structured: records are appended in sequence through
+ * JOURNAL_SECTORS erase sectors in rotation, and a sector is erased only when
+ * the head moves into it.  Every sector sees the same number of erase cycles,
+ * which is the wear levelling.  A record is complete when its last word holds
+ * JOURNAL_MAGIC, so a write torn by a reset is skipped on startup.
+ *
+ * Record layout, 16-bit words:
+ * + 0-1   sequence number
+ * + 2-5   EventTicks
+ * + 6-7   EventTime1
+ * + 8-9   EventTime2
+ * + 10    EventCode
+ * + 11    EventData1
+ * + 12-13 EventData2
+ * + 14    checksum over words 0-13
+ * + 15    JOURNAL_MAGIC
+ *
+ * NvRead, NvWrite and NvErase are board support.  The host build (HOST_SIM)
+ * keeps the store in the file JOURNAL_FILE.
+ *
+ * Enable with EVENT_JOURNAL, InitEvents then calls InitJournal and the
+ * background loop calls UpdateJournal.
+ */
+
+#include "Setup.h"     // DSP2833x Headerfile Include File
+
+#if(EVENT_JOURNAL)
+
+#define JOURNAL_SLOTS	(JOURNAL_SECTOR_WORDS/JOURNAL_REC_WORDS)	/**< records per sector */
+
+int JournalSector = 0;			/**< Journal, sector holding the head */
+int JournalSlot = 0;			/**< Journal, next record slot within the head sector */
+unsigned long JournalSeq = 1L;	/**< Journal, sequence number of the next record */
+unsigned long JournalTotal = 0L;	/**< Journal, value of EventTotal already journaled */
+int JournalIndex = 0;			/**< Journal, next event log slot to journal */
+int JournalLost = 0;			/**< Journal, events overwritten in RAM before they were journaled */
+
+extern long EventTime1[];
+extern long EventTime2[];
+extern int EventCode[];
+extern int EventData1[];
+extern float EventData2[];
+extern unsigned long long EventTicks[];
+extern int EventIndex;
+extern unsigned long EventTotal;
+
+/** Checksum of a record, words 0 to 13 */
+static unsigned int JournalSum(const unsigned int *rec){
+
+	unsigned int sum = 0x1D0F;
+	int i;
+
+	for(i=0;i<JOURNAL_REC_WORDS-2;i++){
+		sum = ((sum<<1) | ((sum>>15)&1)) & 0xFFFF;
+		sum = sum ^ (rec[i]&0xFFFF);
+	}
+	return sum;
+}
+
+/** Read record slot of a sector, returns 1 when it holds a complete record */
+static int JournalRead(int sector, int slot, unsigned int *rec){
+
+	NvRead((long)sector*JOURNAL_SECTOR_WORDS + (long)slot*JOURNAL_REC_WORDS, rec, JOURNAL_REC_WORDS);
+	return (rec[JOURNAL_REC_WORDS-1]==JOURNAL_MAGIC) && (rec[JOURNAL_REC_WORDS-2]==JournalSum(rec));
+}
+
+/** Sequence number stored in a record */
+static unsigned long JournalRecSeq(const unsigned int *rec){
+
+	return ((unsigned long)(rec[0]&0xFFFF)<<16) | (rec[1]&0xFFFF);
+}
+
+/** Pack event log slot i into a journal record */
+static void JournalPack(int i, unsigned long seq, unsigned int *rec){
+
+	union { float f; unsigned long l; } d2;
+	unsigned long long t;
+
+	t = EventTicks[i];
+	d2.f = EventData2[i];
+	rec[0] = (unsigned int)(seq>>16) & 0xFFFF;
+	rec[1] = (unsigned int)seq & 0xFFFF;
+	rec[2] = (unsigned int)(t>>48) & 0xFFFF;
+	rec[3] = (unsigned int)(t>>32) & 0xFFFF;
+	rec[4] = (unsigned int)(t>>16) & 0xFFFF;
+	rec[5] = (unsigned int)t & 0xFFFF;
+	rec[6] = (unsigned int)((unsigned long)EventTime1[i]>>16) & 0xFFFF;
+	rec[7] = (unsigned int)EventTime1[i] & 0xFFFF;
+	rec[8] = (unsigned int)((unsigned long)EventTime2[i]>>16) & 0xFFFF;
+	rec[9] = (unsigned int)EventTime2[i] & 0xFFFF;
+	rec[10] = (unsigned int)EventCode[i] & 0xFFFF;
+	rec[11] = (unsigned int)EventData1[i] & 0xFFFF;
+	rec[12] = (unsigned int)(d2.l>>16) & 0xFFFF;
+	rec[13] = (unsigned int)d2.l & 0xFFFF;
+	rec[14] = JournalSum(rec);
+	rec[15] = JOURNAL_MAGIC;
+}
+
+/** Put a journal record back into the event log */
+static void JournalUnpack(const unsigned int *rec){
+
+	union { float f; unsigned long l; } d2;
+	unsigned long long t;
+	long t1;
+	long t2;
+
+	t = ((unsigned long long)(rec[2]&0xFFFF)<<48) | ((unsigned long long)(rec[3]&0xFFFF)<<32)
+		| ((unsigned long long)(rec[4]&0xFFFF)<<16) | (rec[5]&0xFFFF);
+	t1 = (long)(((unsigned long)(rec[6]&0xFFFF)<<16) | (rec[7]&0xFFFF));
+	t2 = (long)(((unsigned long)(rec[8]&0xFFFF)<<16) | (rec[9]&0xFFFF));
+	d2.l = ((unsigned long)(rec[12]&0xFFFF)<<16) | (rec[13]&0xFFFF);
+	WriteEvent(t,t1,t2,(int)(short)rec[10],(int)(short)rec[11],d2.f);
+}
+
+/** Find the journal head and, when restore is set, rebuild the last
+ *  JOURNAL_RESTORE events.  Called from InitEvents, a warm start keeps the
+ *  log in RAM and only needs the head. */
+void InitJournal(int restore){
+
+	unsigned int rec[JOURNAL_REC_WORDS];
+	unsigned long seq;
+	unsigned long best = 0L;
+	int found = 0;
+	int sector;
+	int slot;
+	int n;
+
+	// The newest sector is the one whose first record has the highest sequence
+	JournalSector = 0;
+	for(sector=0;sector<JOURNAL_SECTORS;sector++){
+		if(JournalRead(sector,0,rec)){
+			seq = JournalRecSeq(rec);
+			if(!found || seq>best){
+				best = seq;
+				JournalSector = sector;
+				found = 1;
+			}
+		}
+	}
+
+	if(!found){
+		// Empty journal, start fresh in sector 0
+		NvErase(0);
+		JournalSector = 0;
+		JournalSlot = 0;
+		JournalSeq = 1L;
+	}else{
+		// Walk the head sector to the first free slot
+		for(slot=0;slot<JOURNAL_SLOTS;slot++){
+			if(!JournalRead(JournalSector,slot,rec)) break;
+			best = JournalRecSeq(rec);
+		}
+		JournalSlot = slot;
+		JournalSeq = best + 1L;
+
+		// Step back over the newest records, then replay them oldest first
+		sector = JournalSector;
+		slot = JournalSlot;
+		for(n=0;n<JOURNAL_RESTORE;n++){
+			if(slot==0){
+				sector = (sector==0) ? JOURNAL_SECTORS-1 : sector-1;
+				slot = JOURNAL_SLOTS;
+			}
+			slot--;
+			if(!JournalRead(sector,slot,rec) || JournalRecSeq(rec)!=JournalSeq-1L-n){
+				slot++;
+				if(slot==JOURNAL_SLOTS){
+					slot = 0;
+					sector = (sector+1) % JOURNAL_SECTORS;
+				}
+				break;
+			}
+		}
+		while(restore && n-->0){
+			if(JournalRead(sector,slot,rec)) JournalUnpack(rec);
+			slot++;
+			if(slot==JOURNAL_SLOTS){
+				slot = 0;
+				sector = (sector+1) % JOURNAL_SECTORS;
+			}
+		}
+	}
+
+	// Events replayed from the journal are already stored
+	JournalIndex = EventIndex;
+	JournalTotal = EventTotal;
+	JournalLost = 0;
+}
+
+/** Append new event log records to the journal, call from the background loop */
+void UpdateJournal(void){
+
+	unsigned int rec[JOURNAL_REC_WORDS];
+	int n;
+
+	// Skip ahead if the ring has lapped the journal
+	if(EventTotal - JournalTotal > EVENT_SIZE){
+		JournalLost += (int)(EventTotal - JournalTotal - EVENT_SIZE);
+		JournalTotal = EventTotal - EVENT_SIZE;
+		JournalIndex = EventIndex;
+	}
+
+	for(n=0;n<JOURNAL_PER_PASS && JournalTotal!=EventTotal;n++){
+		if(JournalSlot==JOURNAL_SLOTS){
+			// Move the head into the next sector, oldest records go
+			JournalSector = (JournalSector+1) % JOURNAL_SECTORS;
+			JournalSlot = 0;
+			NvErase(JournalSector);
+		}
+		JournalPack(JournalIndex,JournalSeq,rec);
+		NvWrite((long)JournalSector*JOURNAL_SECTOR_WORDS + (long)JournalSlot*JOURNAL_REC_WORDS, rec, JOURNAL_REC_WORDS);
+		JournalSlot++;
+		JournalSeq++;
+		JournalTotal++;
+		JournalIndex++;
+		if(JournalIndex==EVENT_SIZE) JournalIndex = 0;
+	}
+}
+
+#ifdef HOST_SIM
+#include <stdio.h>
+
+#ifndef JOURNAL_FILE
+#define JOURNAL_FILE	"journal.bin"	/**< Journal, host file standing in for flash */
+#endif
+
+static FILE *NvFile = NULL;
+
+/** Open the host journal file, creating it on first use */
+static FILE *NvOpen(void){
+
+	if(NvFile==NULL){
+		NvFile = fopen(JOURNAL_FILE,"r+b");
+		if(NvFile==NULL) NvFile = fopen(JOURNAL_FILE,"w+b");
+	}
+	return NvFile;
+}
+
+/** Host stand-in, words past the end of the file read as erased */
+void NvRead(long addr, unsigned int *buf, int n){
+
+	FILE *f = NvOpen();
+	size_t got = 0;
+	int i;
+
+	if(f!=NULL && fseek(f,addr*(long)sizeof(unsigned int),SEEK_SET)==0){
+		got = fread(buf,sizeof(unsigned int),n,f);
+	}
+	for(i=(int)got;i<n;i++) buf[i] = NV_ERASED;
+}
+
+/** Host stand-in for programming words */
+void NvWrite(long addr, const unsigned int *buf, int n){
+
+	FILE *f = NvOpen();
+
+	if(f==NULL) return;
+	fseek(f,addr*(long)sizeof(unsigned int),SEEK_SET);
+	fwrite(buf,sizeof(unsigned int),n,f);
+	fflush(f);
+}
+
+/** Host stand-in for erasing a sector */
+void NvErase(int sector){
+
+	unsigned int blank[JOURNAL_REC_WORDS];
+	long i;
+
+	for(i=0;i<JOURNAL_REC_WORDS;i++) blank[i] = NV_ERASED;
+	for(i=0;i<JOURNAL_SECTOR_WORDS;i+=JOURNAL_REC_WORDS){
+		NvWrite((long)sector*JOURNAL_SECTOR_WORDS + i, blank, JOURNAL_REC_WORDS);
+	}
+}
+#endif
+
+#endif
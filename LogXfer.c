@@ -0,0 +1,604 @@
+/**
+ * @file LogXfer.c
+ * @brief Windowed block transfer of the logs over CANbus.
+ *
+ * Reading LogBuf and the event arrays one word per request takes tens of
+ * seconds.  This sender streams a region as numbered data frames, keeping
+ * up to XferWindow frames in flight ahead of the last acknowledgement, so
+ * the bus runs near line rate.
+ *
+ * Frames carry four 16-bit words, high byte first on the wire.
+ *
+ * Host to target, id XFER_RX_ID, word 0 is the command in the high byte:
+ * + XFER_START  w0 low byte region, w1-w2 word offset, w3 word count
+ * + XFER_ACK    w1 next sequence number expected, all below it arrived
+ * + XFER_STOP   abandon the transfer
+ * + XFER_SET    w0 low byte XFER_V_* setting, w1-w2 new value, answered
+ *               with a reply frame
+ * + XFER_GET    w0 low byte XFER_V_* setting, answered with a reply frame
+ * + XFER_RESET  ResetFaults
+ *
+ * Target to host, id XFER_TX_ID:
+ * + data        w0 sequence number, w1-w3 three words from
+ *               offset + 3*sequence, the last frame padded with zeros
+ * + reply       w0 XFER_REPLY, w1 setting, w2-w3 value, to an XFER_SET
+ *               out of range w1 has XFER_REJECT added and the setting is
+ *               left as it was
+ *
+ * An ACK that does not move forward for XferTimeout ISR ticks sends the
+ * window again from the acknowledged point (go-back-N).  A transfer cut
+ * short resumes with a new XFER_START at the offset of the first missing
+ * frame.  Regions are listed in Logs.h as XFER_R_*.
+ *
+ * CanTxFree and CanTxFrame are board support, the CAN receive handler
+ * passes frames for XFER_RX_ID to XferReceive.  XferReceive only queues the
+ * frame, UpdateXfer runs in the background loop and carries out every
+ * queued command before it sends, so a command never lands in the middle
+ * of a send pass and ResetFaults stays out of the interrupt.
+ *
+ * Regions are described by their parts in target widths, int 1 word, long
+ * and float 2, a tick 4, so a tool sees the same layout from any build.  A
+ * region whose parts are laid out in memory as on the wire is streamed from
+ * memory as it is, which on the DSP is every region but XFER_R_INDEX.  The
+ * others are packed into XferImage when their XFER_START arrives, with the
+ * interrupts held, so the log positions and the capture header of the
+ * index agree with each other.  A packed region is a snapshot, a resumed
+ * transfer packs it again.
+ *
+ * The host build (HOST_SIM) carries the same frames over Linux SocketCAN or
+ * a Unix datagram socket, so log readout tools can be developed and
+ * benchmarked against the real Logs.c without a drive.  Its int and long
+ * regions are packed, and a LogAddr_t, a 64-bit pointer there, travels as
+ * a signed 32-bit byte offset from &LogAddr0 with 0 for none, in
+ * XFER_SET/XFER_GET and in the index alike.  The offset of a variable is
+ * its address less that of LogAddr0 in the symbol table (nm) of the
+ * simulation.
+ *
+ * This code is for TI 28335 DSP.  Adapt it for other platforms.
+ */
+
+#include <limits.h>
+#include "Setup.h"     // DSP2833x Headerfile Include File
+
+extern float LogBuf[];
+extern long EventTime1[];
+extern long EventTime2[];
+extern int EventCode[];
+extern int EventData1[];
+extern float EventData2[];
+extern unsigned long long EventTicks[];
+extern unsigned int EventCrc[];
+extern unsigned int EventVar[];
+extern int LogTrigger;
+extern int LogInit;
+extern int LogChan;
+extern int LogSkip;
+extern int LogSingle;
+extern int LogAuto;
+extern int LogHold;
+extern int LogQ15;
+extern LogAddr_t LogAddr0, LogAddr1, LogAddr2, LogAddr3, LogAddr4;
+extern LogAddr_t LogAddr5, LogAddr6, LogAddr7, LogAddr8;
+extern int EventIndex;
+extern unsigned long EventTotal;
+extern int EventVarHead;
+extern int EventVarTail;
+extern int EventVarSize;
+extern int LogLength;
+extern int LogCount;
+extern unsigned long long LogHdrStart;
+extern unsigned long LogHdrSamples;
+extern int LogHdrPeriod;
+extern int LogHdrTrigger;
+extern unsigned long long LogHdrTrigTick;
+extern LogAddr_t LogHdrAddr[];
+extern int LogHdrType[];
+extern int LogMarkIndex;
+extern unsigned long LogMarkSample[];
+extern unsigned long long LogMarkTick[];
+extern int LogMarkPeriod[];
+
+#ifdef HOST_SIM
+#define XFER_LOCK()			0
+#define XFER_UNLOCK(s)		(void)(s)
+#else
+#define XFER_LOCK()			__disable_interrupts()
+#define XFER_UNLOCK(s)		__restore_interrupts(s)
+#endif
+
+// Part of a region, Count elements of Size each (sizeof units) put out as
+// Width 16-bit words each, low word first as the target stores them.  Addr
+// marks LogAddr_t elements, which the host build turns into offsets.
+typedef struct {
+	const void *Base;		/**< first element */
+	unsigned int Count;		/**< number of elements */
+	unsigned int Size;		/**< sizeof one element */
+	unsigned int Width;		/**< target words of one element */
+	int Addr;				/**< 1 for a LogAddr_t */
+} XferPart;
+
+#define XP(x,n,w)	{ (const void *)(x), (n), sizeof(*(x)), (w), 0 }
+#define XA(x,n)		{ (const void *)(x), (n), sizeof(*(x)), 2, 1 }
+#define XR(p)		{ p, sizeof(p)/sizeof(p[0]) }
+
+typedef struct {
+	const XferPart *Parts;	/**< parts in order */
+	int Count;				/**< number of parts */
+} XferRegion;
+
+static const XferPart XferLogBuf[] = { XP(LogBuf,LOG_SIZE,2) };
+static const XferPart XferTime1[] = { XP(EventTime1,EVENT_SIZE,2) };
+static const XferPart XferTime2[] = { XP(EventTime2,EVENT_SIZE,2) };
+static const XferPart XferCode[] = { XP(EventCode,EVENT_SIZE,1) };
+static const XferPart XferData1[] = { XP(EventData1,EVENT_SIZE,1) };
+static const XferPart XferData2[] = { XP(EventData2,EVENT_SIZE,2) };
+static const XferPart XferTicks[] = { XP(EventTicks,EVENT_SIZE,4) };
+static const XferPart XferCrc[] = { XP(EventCrc,EVENT_SIZE,1) };
+static const XferPart XferVar[] = { XP(EventVar,EVENT_VAR_SIZE,1) };
+static const XferPart XferStats[] = {
+	XP(LogStats.EventCount,EVENT_CODES,2),
+	XP(LogStats.FaultCount,FAULT_COUNT,2),
+#if(EVENT_HIST)
+	XP(&LogStats.EventHist[0][0],EVENT_CODES*EVENT_HIST_BINS,1),
+	XP(&LogStats.FaultHist[0][0],FAULT_COUNT*EVENT_HIST_BINS,1)
+#endif
+};
+
+// The index, layout in Logs.h above XFER_INDEX_WORDS
+static const XferPart XferIndex[] = {
+	XP(&EventIndex,1,1), XP(&EventTotal,1,2),
+	XP(&EventVarHead,1,1), XP(&EventVarTail,1,1), XP(&EventVarSize,1,1),
+	XP(&LogLength,1,1), XP(&LogCount,1,1),
+	XP(&LogHdrStart,1,4), XP(&LogHdrSamples,1,2),
+	XP(&LogHdrPeriod,1,1), XP(&LogHdrTrigger,1,1), XP(&LogHdrTrigTick,1,4),
+	XA(LogHdrAddr,LOG_CHAN), XP(LogHdrType,LOG_CHAN,1),
+	XP(&LogMarkIndex,1,1), XP(LogMarkSample,LOG_MARKS,2),
+	XP(LogMarkTick,LOG_MARKS,4), XP(LogMarkPeriod,LOG_MARKS,1)
+};
+
+static const XferRegion XferRegions[XFER_REGIONS] = {
+	XR(XferLogBuf), XR(XferTime1), XR(XferTime2), XR(XferCode),
+	XR(XferData1), XR(XferData2), XR(XferTicks), XR(XferCrc),
+	XR(XferVar), XR(XferStats), XR(XferIndex)
+};
+
+// The DSP packs only the index, the host packs every int and long region
+#ifdef HOST_SIM
+#define XFER_IMAGE_WORDS	(XFER_INDEX_WORDS + LOG_STATS_WORDS + 2L*EVENT_SIZE + EVENT_VAR_SIZE)
+#else
+#define XFER_IMAGE_WORDS	XFER_INDEX_WORDS
+#endif
+
+// A LogAddr_t on the wire, see the top of the file
+#ifdef HOST_SIM
+#define XFER_ADDR_OUT(a)	((a)==0 ? 0L : (long)((a) - (LogAddr_t)&LogAddr0))
+#define XFER_ADDR_IN(v)		((v)==0 ? (LogAddr_t)0 : (LogAddr_t)&LogAddr0 + (v))
+#else
+#define XFER_ADDR_OUT(a)	((long)(unsigned int)(a))
+#define XFER_ADDR_IN(v)		((LogAddr_t)(v))
+#endif
+
+// Settings reachable with XFER_SET and XFER_GET, in XFER_V_* order
+static int * const XferInts[XFER_V_ADDR0] = {
+	&LogTrigger, &LogInit, &LogChan, &LogSkip, &LogSingle, &LogAuto, &LogHold
+};
+static LogAddr_t * const XferAddrs[LOG_CHAN] = {
+	&LogAddr0, &LogAddr1, &LogAddr2, &LogAddr3, &LogAddr4,
+	&LogAddr5, &LogAddr6, &LogAddr7, &LogAddr8
+};
+
+unsigned short XferQ[XFER_QSIZE][4];	/**< Xfer, command frames from XferReceive */
+volatile int XferQHead = 0;		/**< Xfer, next queue slot to fill, written by XferReceive only */
+volatile int XferQTail = 0;		/**< Xfer, next queue slot to run, written by UpdateXfer only */
+int XferQLost = 0;				/**< Xfer, commands dropped because the queue was full */
+unsigned short XferImage[XFER_IMAGE_WORDS];	/**< Xfer, packed copy of the region being sent */
+
+const unsigned short *XferBase = 0;	/**< Xfer, first word of the transfer */
+unsigned int XferFrames = 0;	/**< Xfer, frames in the transfer, 0 when idle */
+unsigned long XferWordsLeft = 0L;	/**< Xfer, words from XferBase to the end of the transfer */
+unsigned int XferNext = 0;		/**< Xfer, next sequence number to send */
+unsigned int XferAcked = 0;		/**< Xfer, every sequence number below this has arrived */
+int XferWindow = XFER_WINDOW;	/**< Xfer, frames allowed in flight */
+long XferTimeout = XFER_TIMEOUT;	/**< Xfer, ISR ticks without progress before resending */
+unsigned long long XferLastAck = 0;	/**< Xfer, tick of the last forward ACK */
+int XferResends = 0;			/**< Xfer, go-back-N restarts in this transfer */
+
+/** Words of a region on the wire */
+static unsigned long XferWords(const XferRegion *r){
+
+	unsigned long words = 0L;
+	int i;
+
+	for(i=0;i<r->Count;i++){
+		words += (unsigned long)r->Parts[i].Count * r->Parts[i].Width;
+	}
+	return words;
+}
+
+/** First word of a region that is laid out in memory as on the wire,
+ *  0 when it has to be packed */
+static const unsigned short *XferInPlace(const XferRegion *r){
+
+	const XferPart *p = r->Parts;
+	const unsigned char *next = (const unsigned char *)p->Base;
+	int i;
+
+	for(i=0;i<r->Count;i++,p++){
+		if(p->Addr || p->Size*CHAR_BIT!=p->Width*16 || (const unsigned char *)p->Base!=next) return 0;
+		next += (unsigned long)p->Count * p->Size;
+	}
+	return (const unsigned short *)r->Parts[0].Base;
+}
+
+/** Pack the parts of a region into XferImage.  An element is read as an
+ *  integer stored low unit first, as on the C28x and on the little endian
+ *  hosts the simulation runs on. */
+static void XferPack(const XferRegion *r){
+
+	const XferPart *p = r->Parts;
+	const unsigned char *b;
+	unsigned long long v;
+	unsigned long k = 0L;
+	unsigned int e;
+	unsigned int j;
+	int i;
+
+	for(i=0;i<r->Count;i++,p++){
+		b = (const unsigned char *)p->Base;
+		for(e=0;e<p->Count;e++,b+=p->Size){
+			v = 0;
+			for(j=p->Size;j>0;j--){
+				v = (v<<CHAR_BIT) | b[j-1];
+			}
+			if(p->Addr) v = (unsigned long)XFER_ADDR_OUT((LogAddr_t)v);
+			for(j=0;j<p->Width;j++){
+				XferImage[k++] = (unsigned short)(v>>(16*j));
+			}
+		}
+	}
+}
+
+/** Signed 32-bit value of two words, high word first */
+static long XferLong(unsigned int hi, unsigned int lo){
+
+	unsigned long u = ((unsigned long)(hi & 0xFFFF)<<16) | (lo & 0xFFFF);
+
+	return (u & 0x80000000UL) ? -(long)(~u & 0x7FFFFFFFUL) - 1L : (long)u;
+}
+
+/** Start a transfer of count words from offset within a region */
+static void XferStart(int region, unsigned long offset, unsigned int count){
+
+	const XferRegion *r;
+	const unsigned short *base;
+	unsigned long words;
+	unsigned int s;
+
+	XferFrames = 0;
+	if(region<0 || region>=XFER_REGIONS) return;
+	r = &XferRegions[region];
+	words = XferWords(r);
+	if(offset>=words) return;
+	if(count==0 || offset+count>words) count = (unsigned int)(words - offset);
+
+	base = XferInPlace(r);
+	if(base==0){
+		if(words>XFER_IMAGE_WORDS) return;
+		s = XFER_LOCK();
+		XferPack(r);
+		XFER_UNLOCK(s);
+		base = XferImage;
+	}
+	XferBase = base + offset;
+	XferWordsLeft = count;
+	XferNext = 0;
+	XferAcked = 0;
+	XferResends = 0;
+	XferLastAck = LogTickNow();
+	XferFrames = (count + 2) / 3;
+}
+
+/** Value of a setting */
+static long XferValue(int v){
+
+	if(v<XFER_V_ADDR0) return *XferInts[v];
+	if(v==XFER_V_Q15) return LogQ15;
+	return XFER_ADDR_OUT(*XferAddrs[v-XFER_V_ADDR0]);
+}
+
+/** Whether value is in range for setting v, the ints of the target are
+ *  16 bits and the ISR divides by LogChan and indexes LogPtr with it */
+static int XferValid(int v, long value){
+
+	switch(v){
+	case XFER_V_CHAN:
+		return value>=1L && value<=LOG_CHAN;
+	case XFER_V_SKIP:
+		return value>=0L && value<32767L;	// LogSkip+1 is the period
+	case XFER_V_SINGLE:
+	case XFER_V_HOLD:
+		return value==0L || value==1L;
+	case XFER_V_Q15:
+		return value>=0L && value<(1L<<LOG_CHAN);
+	default:
+		break;
+	}
+	if(v<XFER_V_ADDR0) return value>=-32768L && value<=32767L;
+	return (value & ~(long)LOG_ADDR_MASK)==0L;
+}
+
+/** Send a reply frame, w1 the setting with XFER_REJECT when refused */
+static void XferReply(unsigned int w1, long value){
+
+	unsigned short f[4];
+
+	f[0] = XFER_REPLY;
+	f[1] = (unsigned short)w1;
+	f[2] = (unsigned short)((unsigned long)value>>16);
+	f[3] = (unsigned short)value;
+	CanTxFrame(XFER_TX_ID,f);
+}
+
+/** Write a setting and answer with the value it holds, a value out of
+ *  range is refused with XFER_REJECT.  LogLength only follows LogChan in
+ *  InitLog, so a new LogChan starts a new capture with LogInit before the
+ *  ISR can record with the old length. */
+static void XferSet(int v, long value){
+
+	unsigned int s;
+
+	if(v<0 || v>=XFER_SETTINGS) return;
+	if(!XferValid(v,value)){
+		XferReply(v | XFER_REJECT, XferValue(v));
+		return;
+	}
+	if(v==XFER_V_CHAN){
+		s = XFER_LOCK();
+		LogChan = (int)value;
+		LogInit = 1;
+		XFER_UNLOCK(s);
+	}else if(v<XFER_V_ADDR0){
+		*XferInts[v] = (int)value;
+	}else if(v==XFER_V_Q15){
+		LogQ15 = (int)value;
+	}else{
+		*XferAddrs[v-XFER_V_ADDR0] = XFER_ADDR_IN(value);
+	}
+	XferReply(v, XferValue(v));
+}
+
+/** Answer XFER_GET with the value of a setting */
+static void XferGet(int v){
+
+	if(v<0 || v>=XFER_SETTINGS) return;
+	XferReply(v, XferValue(v));
+}
+
+/** Carry out a queued command frame */
+static void XferCommand(const unsigned short *w){
+
+	unsigned int ack;
+
+	switch((w[0]>>8) & 0xFF){
+	case XFER_START:
+		XferStart(w[0] & 0xFF, ((unsigned long)w[1]<<16) | w[2], w[3]);
+		break;
+	case XFER_ACK:
+		ack = w[1];
+		if(ack>XferAcked && ack<=XferFrames){
+			XferAcked = ack;
+			XferLastAck = LogTickNow();
+			if(XferNext<XferAcked) XferNext = XferAcked;
+		}
+		break;
+	case XFER_STOP:
+		XferFrames = 0;
+		break;
+	case XFER_SET:
+		XferSet(w[0] & 0xFF, XferLong(w[1],w[2]));
+		break;
+	case XFER_GET:
+		XferGet(w[0] & 0xFF);
+		break;
+	case XFER_RESET:
+		ResetFaults();
+		break;
+	default:
+		break;
+	}
+}
+
+/** Queue a command frame from the host, called by the CAN receive handler.
+ *  When the queue is full the frame is dropped and counted in XferQLost,
+ *  the tool times out and repeats it. */
+void XferReceive(const unsigned short *w){
+
+	int i;
+	int next;
+
+	i = XferQHead;
+	next = (i+1) & (XFER_QSIZE-1);
+	if(next==XferQTail){
+		XferQLost++;
+		return;
+	}
+	XferQ[i][0] = w[0];
+	XferQ[i][1] = w[1];
+	XferQ[i][2] = w[2];
+	XferQ[i][3] = w[3];
+	XferQHead = next;
+}
+
+/** Run the queued commands, then send data frames while the window and
+ *  the CAN mailboxes allow, call from the background loop */
+void UpdateXfer(void){
+
+	unsigned short f[4];
+	unsigned long at;
+	int i;
+
+	// Commands first, in the order they arrived
+	while(XferQTail!=XferQHead){
+		i = XferQTail;
+		XferCommand(XferQ[i]);
+		XferQTail = (i+1) & (XFER_QSIZE-1);
+	}
+
+	if(XferFrames==0) return;
+
+	// Finished when the host has everything
+	if(XferAcked>=XferFrames){
+		XferFrames = 0;
+		return;
+	}
+
+	// No progress, go back to the first unacknowledged frame
+	if(((LogTickNow() - XferLastAck)>>LOG_SUBTICK_BITS) > (unsigned long long)XferTimeout){
+		XferNext = XferAcked;
+		XferLastAck = LogTickNow();
+		XferResends++;
+	}
+
+	while(XferNext<XferFrames && XferNext<XferAcked+XferWindow && CanTxFree()){
+		at = 3L*XferNext;
+		f[0] = XferNext;
+		for(i=0;i<3;i++){
+			f[i+1] = (at+i<XferWordsLeft) ? XferBase[at+i] : 0;
+		}
+		CanTxFrame(XFER_TX_ID,f);
+		XferNext++;
+	}
+}
+
+#ifdef HOST_SIM
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <linux/can.h>
+
+static int XferSock = -1;				/**< Xfer host, socket carrying the frames */
+static struct sockaddr_un XferPeer;		/**< Xfer host, tool address for the Unix socket */
+static int XferUnix = 0;				/**< Xfer host, 1 for a Unix socket, 0 for SocketCAN */
+static struct can_frame XferHeld;		/**< Xfer host, frame the socket had no room for */
+static int XferHeldOn = 0;				/**< Xfer host, 1 while XferHeld waits, the mailbox is busy */
+
+/** Host build, open the link.  "vcan0" or any CAN interface uses SocketCAN,
+ *  "unix:<path>" binds a Unix datagram socket at <path> and answers the
+ *  last tool that sent to it.  Returns 0 when open. */
+int XferHostOpen(const char *name){
+
+	struct sockaddr_can can;
+	struct sockaddr_un un;
+	struct ifreq ifr;
+
+	if(strncmp(name,"unix:",5)==0){
+		XferUnix = 1;
+		XferSock = socket(AF_UNIX,SOCK_DGRAM,0);
+		if(XferSock<0) return -1;
+		memset(&un,0,sizeof(un));
+		un.sun_family = AF_UNIX;
+		strncpy(un.sun_path,name+5,sizeof(un.sun_path)-1);
+		unlink(un.sun_path);
+		if(bind(XferSock,(struct sockaddr *)&un,sizeof(un))==0) return 0;
+		XferHostClose();
+		return -1;
+	}
+
+	XferUnix = 0;
+	XferSock = socket(PF_CAN,SOCK_RAW,CAN_RAW);
+	if(XferSock<0) return -1;
+	memset(&ifr,0,sizeof(ifr));
+	strncpy(ifr.ifr_name,name,IFNAMSIZ-1);
+	if(ioctl(XferSock,SIOCGIFINDEX,&ifr)<0){
+		XferHostClose();
+		return -1;
+	}
+	memset(&can,0,sizeof(can));
+	can.can_family = AF_CAN;
+	can.can_ifindex = ifr.ifr_ifindex;
+	if(bind(XferSock,(struct sockaddr *)&can,sizeof(can))==0) return 0;
+	XferHostClose();
+	return -1;
+}
+
+/** Host build, close the link */
+void XferHostClose(void){
+
+	if(XferSock>=0) close(XferSock);
+	XferSock = -1;
+	XferHeldOn = 0;
+	memset(&XferPeer,0,sizeof(XferPeer));
+}
+
+/** Host build, put a frame on the link without blocking, returns 0 when
+ *  the socket had no room */
+static int XferHostSend(const struct can_frame *fr){
+
+	long n;
+
+	if(XferUnix){
+		if(XferPeer.sun_family!=AF_UNIX) return 1;
+		n = sendto(XferSock,fr,sizeof(*fr),MSG_DONTWAIT,(struct sockaddr *)&XferPeer,sizeof(XferPeer));
+	}else{
+		n = send(XferSock,fr,sizeof(*fr),MSG_DONTWAIT);
+	}
+	return !(n<0 && (errno==EAGAIN || errno==EWOULDBLOCK || errno==ENOBUFS));
+}
+
+/** Host build, free once the frame held back by a full socket has gone,
+ *  as a mailbox is free once its frame is on the bus */
+int CanTxFree(void){
+
+	if(XferSock<0) return 0;
+	if(XferHeldOn && XferHostSend(&XferHeld)) XferHeldOn = 0;
+	return !XferHeldOn;
+}
+
+/** Host build, send one frame, words high byte first as on the target */
+void CanTxFrame(unsigned int id, const unsigned short *w){
+
+	struct can_frame fr;
+	int i;
+
+	if(XferSock<0) return;
+	memset(&fr,0,sizeof(fr));
+	fr.can_id = id;
+	fr.can_dlc = 8;
+	for(i=0;i<4;i++){
+		fr.data[2*i] = (unsigned char)(w[i]>>8);
+		fr.data[2*i+1] = (unsigned char)w[i];
+	}
+	if(XferHeldOn || !XferHostSend(&fr)){
+		XferHeld = fr;
+		XferHeldOn = 1;
+	}
+}
+
+/** Host build, take any waiting command frames and run the sender,
+ *  call from the simulation loop in place of the background loop */
+void XferHostPoll(void){
+
+	struct can_frame fr;
+	struct sockaddr_un from;
+	socklen_t len;
+	unsigned short w[4];
+	int i;
+
+	if(XferSock<0) return;
+	for(;;){
+		len = sizeof(from);
+		if(recvfrom(XferSock,&fr,sizeof(fr),MSG_DONTWAIT,(struct sockaddr *)&from,&len)!=(long)sizeof(fr)) break;
+		if(XferUnix && len>sizeof(sa_family_t)) XferPeer = from;
+		if((fr.can_id & CAN_SFF_MASK)!=XFER_RX_ID) continue;
+		for(i=0;i<4;i++){
+			w[i] = (unsigned short)((fr.data[2*i]<<8) | fr.data[2*i+1]);
+		}
+		XferReceive(w);
+	}
+	UpdateXfer();
+}
+#endif
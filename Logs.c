@@ -20,8 +20,10 @@
  */
 
 #include "Setup.h"     // DSP2833x Headerfile Include File
+#include "SVM.h"
 
 #pragma SET_DATA_SECTION("Logs")	// start of "Logs" data section
+#pragma NOINIT(LogBuf)				// held over a soft reset, see LogHold
 float LogBuf[LOG_SIZE];				/**< Log, buffer of float data */
 #pragma SET_DATA_SECTION()			// end of "Logs" data section
 
@@ -37,64 +39,504 @@ int LogTrigger = 0;			/**< Log, 0=not recording, 1=recording, 2=reset, negative=
 int OldTrigger = 0;			/**< Log, trigger value from prior pass */
 int LogInit = 0;			/**< Log, set non-zero to initialize N channels in the log, resets to 0 when done */
 int LogSkipCount = 0;		/**< Log, counter for skipping samples */
-int LogAddr0;				/**< Log, integer addresses for the data */
-int LogAddr1;				/**< Log, integer addresses for the data */
-int LogAddr2;				/**< Log, integer addresses for the data */
-int LogAddr3;				/**< Log, integer addresses for the data */
-int LogAddr4;				/**< Log, integer addresses for the data */
-int LogAddr5;				/**< Log, integer addresses for the data */
-int LogAddr6;				/**< Log, integer addresses for the data */
-int LogAddr7;				/**< Log, integer addresses for the data */
-int LogAddr8;				/**< Log, integer addresses for the data */
+int LogQ15 = 0;				/**< Log, bit i set when LogAddr<i> points at an _iq15, read at LogInit */
+LogAddr_t LogAddr0;			/**< Log, integer addresses for the data */
+LogAddr_t LogAddr1;			/**< Log, integer addresses for the data */
+LogAddr_t LogAddr2;			/**< Log, integer addresses for the data */
+LogAddr_t LogAddr3;			/**< Log, integer addresses for the data */
+LogAddr_t LogAddr4;			/**< Log, integer addresses for the data */
+LogAddr_t LogAddr5;			/**< Log, integer addresses for the data */
+LogAddr_t LogAddr6;			/**< Log, integer addresses for the data */
+LogAddr_t LogAddr7;			/**< Log, integer addresses for the data */
+LogAddr_t LogAddr8;			/**< Log, integer addresses for the data */
 int LogAuto;				/**< Log, automatic triggering options */
+volatile unsigned long long LogTicks = 0;	/**< Log, ISR tick counter, incremented by UpdateLog */
+
+// Capture header, rewritten by InitLog and kept current by UpdateLog so the
+// host can decode LogBuf exactly.  Ticks are LogTickNow timestamps.
+unsigned long long LogHdrStart = 0;	/**< Log header, timestamp of the first sample of the capture */
+unsigned long LogHdrSamples = 0L;	/**< Log header, samples recorded since InitLog, includes wraps */
+int LogHdrPeriod = 1;				/**< Log header, effective sample period in ISR ticks, LogSkip+1 */
+int LogHdrTrigger = 0;				/**< Log header, LogCount when LogTrigger last changed */
+unsigned long long LogHdrTrigTick = 0;	/**< Log header, timestamp when LogTrigger last changed */
+LogAddr_t LogHdrAddr[LOG_CHAN];		/**< Log header, channel ids, the addresses recorded */
+int LogHdrType[LOG_CHAN];			/**< Log header, channel data types, LOG_FLOAT */
+unsigned long LogMarkSample[LOG_MARKS];		/**< Log markers, sample number, counts like LogHdrSamples */
+unsigned long long LogMarkTick[LOG_MARKS];	/**< Log markers, timestamp of that sample */
+int LogMarkPeriod[LOG_MARKS];		/**< Log markers, sample period in ISR ticks leading up to that sample */
+int LogMarkIndex = 0;				/**< Log markers, index pointing to next slot */
+int LogMarkCount = 0;				/**< Log markers, samples left until the next sparse marker */
 
 #pragma SET_DATA_SECTION("Events")	// start of "Events" data section
+// The log, the counters and the warm start header must survive a soft
+// reset.  An object without an initializer is still zeroed at startup
+// under EABI, so they are NOINIT, cinit neither clears nor loads them.
+// InitEvents decides from the warm start header whether they are valid.
+#pragma NOINIT(EventTime1)
+#pragma NOINIT(EventTime2)
+#pragma NOINIT(EventCode)
+#pragma NOINIT(EventData1)
+#pragma NOINIT(EventData2)
+#pragma NOINIT(EventTicks)
+#pragma NOINIT(EventCrc)
 long EventTime1[EVENT_SIZE];		/**< Events, timestamp part 1 */
 long EventTime2[EVENT_SIZE];		/**< Events, timestamp part 2 */
 int EventCode[EVENT_SIZE];		/**< Events, code defined in Logs.h */
 int EventData1[EVENT_SIZE];		/**< Events, optional integer argument */
 float EventData2[EVENT_SIZE];	/**< Events, optional floating point  */
+unsigned long long EventTicks[EVENT_SIZE];	/**< Events, monotonic 64-bit timestamp, see LogTickNow */
+unsigned int EventCrc[EVENT_SIZE];	/**< Events, CRC-16 over the record, see EventSum */
 int EventIndex = 0;				/**< Events, index pointing to next slot */
+unsigned long EventTotal = 0L;	/**< Events, records written since InitEvents */
 int EventSize = EVENT_SIZE;		/**< Events, EVENT_SIZE in ram to be CANbus readable */
+unsigned long long EventQTick[EVENT_QSIZE];	/**< Events, staging queue, LogTickNow when posted */
+int EventQCode[EVENT_QSIZE];		/**< Events, staging queue, code */
+int EventQData1[EVENT_QSIZE];		/**< Events, staging queue, integer argument */
+float EventQData2[EVENT_QSIZE];		/**< Events, staging queue, floating point argument */
+volatile int EventQHead = 0;		/**< Events, next staging slot to post, written by PostEvent only */
+volatile int EventQTail = 0;		/**< Events, next staging slot to commit, written by CommitEvents only */
+int EventQLost = 0;				/**< Events, posts dropped because the staging queue was full */
+unsigned long long EventTickLast = 0;	/**< Events, newest timestamp written, keeps the log monotonic */
+unsigned long long EventSyncLast = 0;	/**< Events, timestamp of the last E_SYNC record */
+long EventSyncPeriod = 10000L;	/**< Events, ISR ticks between E_SYNC records, 0 to disable */
+unsigned long EventMask = 0xFFFFFFFFUL;	/**< Events, bit n set logs event code n */
+#pragma NOINIT(LogStats)
+LogStatsBlock LogStats;			/**< Events, per-code counters and histograms, one block for CANbus */
+#pragma NOINIT(LogStatsTotal)
+unsigned long LogStatsTotal;	/**< Events, sum of every LogStats counter, moved with each count */
+#pragma NOINIT(EventVar)
+unsigned int EventVar[EVENT_VAR_SIZE];	/**< Events, ring of variable length records, see LogEventWords */
+int EventVarHead = 0;			/**< Events, next free word of EventVar */
+int EventVarTail = 0;			/**< Events, first word of the oldest record in EventVar */
+int EventVarSize = EVENT_VAR_SIZE;	/**< Events, EVENT_VAR_SIZE in ram to be CANbus readable */
+
+// Warm start header, NOINIT like the log it describes
+#pragma NOINIT(WarmMagic)
+#pragma NOINIT(WarmEventIndex)
+#pragma NOINIT(WarmEventTotal)
+#pragma NOINIT(WarmEventVarHead)
+#pragma NOINIT(WarmEventVarTail)
+#pragma NOINIT(WarmEventCrc)
+#pragma NOINIT(WarmLogMagic)
+#pragma NOINIT(WarmLogChan)
+#pragma NOINIT(WarmLogLength)
+#pragma NOINIT(WarmLogCount)
+#pragma NOINIT(WarmLogSamples)
+#pragma NOINIT(WarmLogPeriod)
+#pragma NOINIT(WarmLogAddr)
+#pragma NOINIT(WarmLogQ15)
+#pragma NOINIT(WarmLogBufCrc)
+#pragma NOINIT(WarmLogCrc)
+unsigned int WarmMagic;			/**< Warm start, WARM_MAGIC when the event header is valid */
+int WarmEventIndex;				/**< Warm start, copy of EventIndex */
+unsigned long WarmEventTotal;	/**< Warm start, copy of EventTotal */
+int WarmEventVarHead;			/**< Warm start, copy of EventVarHead */
+int WarmEventVarTail;			/**< Warm start, copy of EventVarTail */
+unsigned int WarmEventCrc;		/**< Warm start, CRC over the event header */
+unsigned int WarmLogMagic;		/**< Warm start, WARM_MAGIC when a frozen capture is sealed */
+int WarmLogChan;				/**< Warm start, LogChan of the sealed capture */
+int WarmLogLength;				/**< Warm start, LogLength of the sealed capture */
+int WarmLogCount;				/**< Warm start, LogCount of the sealed capture */
+unsigned long WarmLogSamples;	/**< Warm start, LogHdrSamples of the sealed capture */
+int WarmLogPeriod;				/**< Warm start, LogHdrPeriod of the sealed capture */
+LogAddr_t WarmLogAddr[LOG_CHAN];	/**< Warm start, LogHdrAddr of the sealed capture */
+unsigned int WarmLogQ15;		/**< Warm start, channels of the sealed capture logged as LOG_Q15 */
+unsigned int WarmLogBufCrc;		/**< Warm start, CRC over LogBuf */
+unsigned int WarmLogCrc;		/**< Warm start, CRC over the capture header */
 #pragma SET_DATA_SECTION()			// end of "Logs" data section
 
-long FaultWord = 0L;
+int EventWarm = 0;				/**< Events, 1 when InitEvents kept the log from before a soft reset */
+int EventBad = 0;				/**< Events, corrupt records found by the last CheckEvents */
+int EventBadFirst = -1;			/**< Events, slot of the first corrupt record, -1 if none */
+int LogHold = 0;				/**< Log, 1 holds a capture kept over a soft reset, clear and set LogInit to release */
 
-/** Assert a fault and log it
- *  fcode is the fault code defined in Logs.h
- *  data2 is a floating point optional argument
- *  that will get recorded in the EventLog */
-void Fault(long fcode, float data2){
+long FaultWord = 0L;		/**< Faults, codes 0 to 31 as bits, kept for CANbus tools */
+unsigned long FaultBits[FAULT_WORDS];	/**< Faults, active bitset, code f is bit f&31 of word f>>5 */
+unsigned long long FaultTick[FAULT_COUNT];	/**< Faults, timestamp of the first occurrence since ResetFaults */
+int FaultsActive = 0;		/**< Faults, number of active fault codes */
+int FaultPending[FAULT_COUNT];	/**< Faults, consecutive assertions not yet confirmed by FaultDebounce */
+unsigned long FaultPendingTick[FAULT_COUNT];	/**< Faults, LogTicks of the last unconfirmed assertion */
+
+// Fault policy, reaction class for each fault code, codes not listed disable
+int FaultClass[FAULT_COUNT] = {
+	FC_DISABLE,		// F_STATE
+	FC_DISABLE,		// F_OVERCURRENT
+	FC_DISABLE,		// F_OVERSPEED
+	FC_DERATE,		// F_OVERTEMP
+	FC_DISABLE,		// F_OVERVOLT
+	FC_DISABLE,		// F_CHECKSUM
+	FC_DISABLE,		// F_WDOG
+	FC_DISABLE,		// F_GROUND
+	FC_DISABLE,		// F_ENCODER
+	FC_DISABLE,		// F_RESOLVER
+	FC_RAMP,		// F_UNDERVOLT
+	FC_DISABLE,		// F_UVLO
+	FC_RAMP,		// F_CANBUS
+	FC_DERATE,		// F_VOLTBALANCE
+	FC_WARN,		// F_OVERRUN
+	FC_WARN,		// F_SPEED
+	FC_DISABLE		// F_STALL
+};
+int FaultDebounce[FC_CLASSES] = { 1, 2, 3, 1 };	/**< Faults, assertions needed before each class reacts */
+float FaultDerate = 1.0;		/**< Faults, output limit scale for the control loops, 1.0 when not derated */
+float FaultDerateLevel = 0.5;	/**< Faults, FaultDerate applied by an FC_DERATE fault */
+int FaultRamp = 0;				/**< Faults, 1 while an FC_RAMP fault is bringing the motor down */
+
+static const unsigned int LogCrcTable[16] = {
+	0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+	0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+/** CRC-16-CCITT of one 16-bit word, a nibble at a time, unrolled */
+#pragma CODE_SECTION(LogCrc, "ramfuncs")
+unsigned int LogCrc(unsigned int crc, unsigned int w){
+
+	crc = ((crc<<4) ^ LogCrcTable[((crc>>12) ^ (w>>12)) & 0x0F]) & 0xFFFF;
+	crc = ((crc<<4) ^ LogCrcTable[((crc>>12) ^ (w>>8)) & 0x0F]) & 0xFFFF;
+	crc = ((crc<<4) ^ LogCrcTable[((crc>>12) ^ (w>>4)) & 0x0F]) & 0xFFFF;
+	return ((crc<<4) ^ LogCrcTable[((crc>>12) ^ w) & 0x0F]) & 0xFFFF;
+}
+
+/** CRC-16-CCITT of a 32-bit value, high word first */
+#pragma CODE_SECTION(LogCrcLong, "ramfuncs")
+unsigned int LogCrcLong(unsigned int crc, unsigned long l){
+
+	crc = LogCrc(crc,(unsigned int)(l>>16) & 0xFFFF);
+	return LogCrc(crc,(unsigned int)l & 0xFFFF);
+}
+
+/** CRC of event log slot i.
+ *  Covers EventTicks, EventTime1, EventTime2, EventCode, EventData1 and the
+ *  bits of EventData2 as 16-bit words, high word first, starting at 0xFFFF.
+ *  The host tool checks records with the same sum. */
+#pragma CODE_SECTION(EventSum, "ramfuncs")
+static unsigned int EventSum(int i){
 
-	// First thing, disable the PWM outputs
-	PWM_disable();
+	union { float f; unsigned long l; } d2;
+	unsigned int crc = 0xFFFF;
+
+	d2.f = EventData2[i];
+	crc = LogCrcLong(crc,(unsigned long)(EventTicks[i]>>32));
+	crc = LogCrcLong(crc,(unsigned long)EventTicks[i]);
+	crc = LogCrcLong(crc,(unsigned long)EventTime1[i]);
+	crc = LogCrcLong(crc,(unsigned long)EventTime2[i]);
+	crc = LogCrc(crc,(unsigned int)EventCode[i] & 0xFFFF);
+	crc = LogCrc(crc,(unsigned int)EventData1[i] & 0xFFFF);
+	return LogCrcLong(crc,d2.l);
+}
+
+/** Scan the event log for corrupt records.
+ *  Returns the number of slots whose CRC does not match, also left in
+ *  EventBad, with the first one in EventBadFirst.  Finds none when built
+ *  without EVENT_CRC. */
+int CheckEvents(void){
+
+	int i;
+
+	EventBad = 0;
+	EventBadFirst = -1;
+	if(!EVENT_CRC) return 0;
+	for(i=0;i<EVENT_SIZE;i++){
+		if(EventCrc[i]!=EventSum(i)){
+			if(EventBad==0) EventBadFirst = i;
+			EventBad++;
+		}
+	}
+	return EventBad;
+}
+
+/** Checksum of the warm start event header */
+static unsigned int WarmEventSum(void){
+
+	unsigned int crc = 0xFFFF;
+
+	crc = LogCrc(crc,WarmMagic);
+	crc = LogCrc(crc,(unsigned int)WarmEventIndex & 0xFFFF);
+	crc = LogCrc(crc,(unsigned int)WarmEventVarHead & 0xFFFF);
+	crc = LogCrc(crc,(unsigned int)WarmEventVarTail & 0xFFFF);
+	return LogCrcLong(crc,WarmEventTotal);
+}
+
+/** Whether EventVar parses as whole records from EventVarTail to
+ *  EventVarHead.  A length below the five header words or past the head
+ *  means a record torn by a reset or hit by a stray write. */
+static int EventVarValid(void){
+
+	int used;
+	int len;
+	int k;
+
+	used = (EventVarHead - EventVarTail) & (EVENT_VAR_SIZE-1);
+	k = EventVarTail;
+	while(used>0){
+		len = (int)(EventVar[k] & 0xFF);
+		if(len<5 || len>used) return 0;
+		k = (k + len) & (EVENT_VAR_SIZE-1);
+		used = used - len;
+	}
+	return 1;
+}
+
+/** Checksum of the warm start capture header */
+static unsigned int WarmLogSum(void){
+
+	unsigned int crc = 0xFFFF;
+	int i;
+
+	crc = LogCrc(crc,WarmLogMagic);
+	crc = LogCrc(crc,(unsigned int)WarmLogChan & 0xFFFF);
+	crc = LogCrc(crc,(unsigned int)WarmLogLength & 0xFFFF);
+	crc = LogCrc(crc,(unsigned int)WarmLogCount & 0xFFFF);
+	crc = LogCrcLong(crc,WarmLogSamples);
+	crc = LogCrc(crc,(unsigned int)WarmLogPeriod & 0xFFFF);
+	for(i=0;i<LOG_CHAN;i++){
+		crc = LogCrcLong(crc,(unsigned long)WarmLogAddr[i]);
+	}
+	crc = LogCrc(crc,WarmLogQ15 & 0xFFFF);
+	return LogCrc(crc,WarmLogBufCrc);
+}
+
+/** Checksum of the LogBuf contents in use */
+static unsigned int LogBufSum(int length){
+
+	union { float f; unsigned long l; } d;
+	unsigned int crc = 0xFFFF;
+	int i;
+
+	for(i=0;i<length;i++){
+		d.f = LogBuf[i];
+		crc = LogCrcLong(crc,d.l);
+	}
+	return crc;
+}
+
+// Posting may come from the ISR or the background, a short hold of the
+// interrupts keeps two posters from claiming the same staging slot.
+#ifdef HOST_SIM
+#define EVENT_LOCK()		0
+#define EVENT_UNLOCK(s)		(void)(s)
+#else
+#define EVENT_LOCK()		__disable_interrupts()
+#define EVENT_UNLOCK(s)		__restore_interrupts(s)
+#endif
+
+/** Log-scale histogram bin of |x|.  Bin 0 holds |x| below
+ *  2^EVENT_HIST_MIN_EXP and zero, each bin above doubles, the last is open. */
+#if(EVENT_HIST)
+#pragma CODE_SECTION(HistBin, "ramfuncs")
+static int HistBin(float x){
+
+	union { float f; unsigned long l; } d;
+	int e;
+
+	d.f = x;
+	e = (int)((d.l>>23) & 0xFF) - 127 - EVENT_HIST_MIN_EXP + 1;
+	if(e<0) e = 0;
+	if(e>=EVENT_HIST_BINS) e = EVENT_HIST_BINS-1;
+	return e;
+}
+#endif
+
+/** Count an event code, and bin Data2 when hist is set.  Saturating.
+ *  The instances of a code share its counters. */
+#pragma CODE_SECTION(CountEvent, "ramfuncs")
+static void CountEvent(int Code, float Data2, int hist){
+
+	unsigned int s;
+
+	Code = Code & EVENT_CODE_MASK;
+	if(Code<0 || Code>=EVENT_CODES) return;
+	s = EVENT_LOCK();
+	if(LogStats.EventCount[Code]<0xFFFFFFFFUL){
+		LogStats.EventCount[Code]++;
+		LogStatsTotal++;
+	}
+#if(EVENT_HIST)
+	if(hist){
+		int b = HistBin(Data2);
+		if(LogStats.EventHist[Code][b]<0xFFFF){
+			LogStats.EventHist[Code][b]++;
+			LogStatsTotal++;
+		}
+	}
+#else
+	(void)Data2; (void)hist;
+#endif
+	EVENT_UNLOCK(s);
+}
+
+/** Count a fault code and bin its data2.  Saturating. */
+#pragma CODE_SECTION(CountFault, "ramfuncs")
+static void CountFault(int fcode, float data2){
+
+	unsigned int s;
+
+	s = EVENT_LOCK();
+	if(LogStats.FaultCount[fcode]<0xFFFFFFFFUL){
+		LogStats.FaultCount[fcode]++;
+		LogStatsTotal++;
+	}
+#if(EVENT_HIST)
+	{
+		int b = HistBin(data2);
+		if(LogStats.FaultHist[fcode][b]<0xFFFF){
+			LogStats.FaultHist[fcode][b]++;
+			LogStatsTotal++;
+		}
+	}
+#else
+	(void)data2;
+#endif
+	EVENT_UNLOCK(s);
+}
+
+/** Clear the event and fault counters and histograms */
+void ClearStats(void){
+
+	unsigned int *p = (unsigned int *)&LogStats;
+	unsigned int i;
+
+	for(i=0;i<sizeof(LogStats)/sizeof(unsigned int);i++){
+		p[i] = 0;
+	}
+	LogStatsTotal = 0UL;
+}
+
+/** Sum of every LogStats counter, LogStatsTotal when the block is intact.
+ *  A CRC would have to be taken again on every count in the ISR, the sum
+ *  moves by one with each count and still shows a torn or stray write. */
+static unsigned long LogStatsSum(void){
+
+	unsigned long sum = 0UL;
+	int i;
+#if(EVENT_HIST)
+	int b;
+#endif
+
+	for(i=0;i<EVENT_CODES;i++){
+		sum += LogStats.EventCount[i];
+#if(EVENT_HIST)
+		for(b=0;b<EVENT_HIST_BINS;b++) sum += LogStats.EventHist[i][b];
+#endif
+	}
+	for(i=0;i<FAULT_COUNT;i++){
+		sum += LogStats.FaultCount[i];
+#if(EVENT_HIST)
+		for(b=0;b<EVENT_HIST_BINS;b++) sum += LogStats.FaultHist[i][b];
+#endif
+	}
+	return sum;
+}
+
+/** Raise a fault, confirmed skips the debounce of its class */
+static void FaultRaise(long fcode, float data2, int confirmed){
+
+	int w;
+	int cls;
+	int react = 0;
+	unsigned long bit;
+	unsigned long tick;
+
+	// An unknown code is itself an invalid state
+	if(fcode<0L || fcode>=FAULT_COUNT) fcode = F_STATE;
+	w = (int)(fcode>>5);
+	bit = 1UL<<(fcode&31);
+	cls = FaultClass[fcode];
+	if(cls<0 || cls>=FC_CLASSES) cls = FC_DISABLE;
+
+	// Count every occurrence
+	CountFault((int)fcode,data2);
 
 	// Check if this is a new fault of this type
-	if((FaultWord & (0x01<<fcode) )==0L){
+	if((FaultBits[w] & bit)==0UL){
+		// Not confirmed until asserted in enough consecutive passes, a
+		// second call in the same pass does not count
+		tick = (unsigned long)LogTicks;
+		if(tick-FaultPendingTick[fcode]>1UL) FaultPending[fcode] = 0;
+		if(FaultPending[fcode]==0 || tick!=FaultPendingTick[fcode]) FaultPending[fcode]++;
+		FaultPendingTick[fcode] = tick;
+		if(!confirmed && FaultPending[fcode]<FaultDebounce[cls]) return;
+		FaultPending[fcode] = 0;
+		react = 1;
+
+		// The disable class still acts before anything else
+		if(cls==FC_DISABLE) PWM_disable();
+
 		// This is a new so log it
-		LogEvent(E_FAULT,fcode,data2);
+		POST_EVENT(E_FAULT,(int)fcode,data2);
+		FaultTick[fcode] = LogTickNow();
+		FaultsActive++;
+
+		// Always set a bit in the fault word
+		FaultBits[w] = FaultBits[w] | bit;
+		if(w==0) FaultWord = (long)FaultBits[0];
 	}
 
-	// Always set a bit in the fault word
-	FaultWord = FaultWord | (0x01<<fcode) ;
+	switch(cls){
+	case FC_DISABLE:
+		// First thing, disable the PWM outputs
+		PWM_disable();
+
+		// Check if just arrived in fault state
+		if(mainState!=FAULT){
+			// Just entered fault state
+			react = 1;
+			mainState=FAULT;
+			POST_EVENT(E_STATE,FAULT,0.0);
+		}
+		// Also stop the drive and keep the data
+		/* fall through */
+	case FC_RAMP:
+		// If auto triggering == 1 turn off data logging
+		// to save the data from this fault
+		if(LogAuto==1){
+			LogTrigger = 0;
+		}
+
+		// Reset the speed reference to zero, with PWM still on
+		// the speed loop brings the motor down under control
+		if(cls==FC_RAMP && (FaultRamp==0 || WeRef!=0)) react = 1;
+		WeRef = 0;
+		if(cls==FC_RAMP) FaultRamp = 1;
+		break;
 
-	// Check if just arrived in fault state
-	if(mainState!=FAULT){
-		// Just entered fault state
-		mainState=FAULT;
-		LogEvent(E_STATE,FAULT,0.0);
+	case FC_DERATE:
+		if(FaultDerate!=FaultDerateLevel) react = 1;
+		FaultDerate = FaultDerateLevel;
+		break;
+
+	default:			// FC_WARN, logged only
+		break;
 	}
 
-	// If auto triggering == 1 turn off data logging
-	// to save the data from this fault
-	if(LogAuto==1){
-		LogTrigger = 0;
+	if(react){
+		POST_EVENT(E_REACT,cls,(float)fcode);
 	}
 
-	// Reset the speed reference to zero
-	WeRef = 0;
+}
+
+/** Assert a fault and log it
+ *  fcode is the fault code defined in Logs.h
+ *  data2 is a floating point optional argument
+ *  that will get recorded in the EventLog
+ *
+ *  The reaction comes from the policy table FaultClass, once the code has
+ *  been asserted in FaultDebounce consecutive ISR passes for its class, an
+ *  ISR pass without the assertion starts the count again.  Each reaction
+ *  that changes something is logged as E_REACT, a derate lifted and then
+ *  applied again by a repeated call logs again. */
+void Fault(long fcode, float data2){
+
+	FaultRaise(fcode,data2,0);
+}
 
+/** Assert a fault that the caller has already debounced, the reaction of
+ *  its class is taken at once.  UpdateFaults calls this when a limit
+ *  confirms, its own counter is the debounce and the limit latches, so
+ *  Fault() would see a single assertion and never reach FaultDebounce. */
+void FaultConfirmed(long fcode, float data2){
 
+	FaultRaise(fcode,data2,1);
 }
 
 /** Reset all the faults, they may be re-asserted
@@ -102,10 +544,24 @@ void Fault(long fcode, float data2){
  */
 void ResetFaults(void){
 
+	int i;
+
+	for(i=0;i<FAULT_WORDS;i++){
+		FaultBits[i] = 0UL;
+	}
+	for(i=0;i<FAULT_COUNT;i++){
+		FaultTick[i] = 0;
+		FaultPending[i] = 0;
+		FaultPendingTick[i] = 0UL;
+	}
+	FaultsActive = 0;
+	FaultDerate = 1.0;
+	FaultRamp = 0;
+	ResetFaultLimits();
 	FaultWord = 0L;
-	LogEvent(E_RESET,0,0);
+	LOG_EVENT(E_RESET,0,0);
 	if(mainState==FAULT){
-		LogEvent(E_STATE,READY,0);
+		LOG_EVENT(E_STATE,READY,0);
 		mainState = READY;
 	}
 	// Toggle on the fault reset line on Flag2
@@ -115,58 +571,443 @@ void ResetFaults(void){
 	FaultResetCount = 20;
 }
 
-/** Initialize the event log */
+/** Returns 1 if fault code fcode is active */
+int FaultActive(int fcode){
+
+	if(fcode<0 || fcode>=FAULT_COUNT) return 0;
+	return (FaultBits[fcode>>5] & (1UL<<(fcode&31))) != 0UL;
+}
+
+/** Next active fault code above fcode, or -1 when there are no more.
+ *  FaultNext(-1) gives the first, whole clear words are skipped. */
+int FaultNext(int fcode){
+
+	unsigned long bits;
+	int w;
+
+	fcode++;
+	if(fcode<0) fcode = 0;
+	while(fcode<FAULT_COUNT){
+		w = fcode>>5;
+		bits = FaultBits[w] >> (fcode&31);
+		if(bits==0UL){
+			fcode = (w+1)<<5;
+		}else{
+			while((bits&1UL)==0UL){
+				bits = bits>>1;
+				fcode++;
+			}
+			return (fcode<FAULT_COUNT) ? fcode : -1;
+		}
+	}
+	return -1;
+}
+
+/** Initialize the event log.
+ *  A cold boot clears the log.  After a soft reset with an intact warm start
+ *  header the log, EventIndex and the timestamps carry on where they were,
+ *  and a sealed datalog capture is held for the host, see LogHold. */
 void InitEvents(void){
 
 	int i;
+	int last;
 
-	for(i=0;i<EVENT_SIZE;i++){
-		EventTime1[i] = 0L;
-		EventTime2[i] = 0L;
-		EventCode[i] = 0;
-		EventData1[i] = 0;
-		EventData2[i] = 0.0;
+	EventWarm = (WarmMagic==WARM_MAGIC) && (WarmEventCrc==WarmEventSum())
+		&& (WarmEventIndex>=0) && (WarmEventIndex<EVENT_SIZE);
+
+	if(EventWarm){
+		EventIndex = WarmEventIndex;
+		EventTotal = WarmEventTotal;
+		EventTickLast = 0;
+		if(EventTotal!=0L){
+			last = (EventIndex==0) ? EVENT_SIZE-1 : EventIndex-1;
+			EventTickLast = EventTicks[last];
+		}
+		// Keep timestamps monotonic across the reset
+		LogTicks = (EventTickLast>>LOG_SUBTICK_BITS) + 1;
+		// Flag any record torn by the reset or hit by a stray write, and
+		// start the counters again when they no longer add up
+		CheckEvents();
+		if(LogStatsSum()!=LogStatsTotal) ClearStats();
+		EventVarHead = WarmEventVarHead & (EVENT_VAR_SIZE-1);
+		EventVarTail = WarmEventVarTail & (EVENT_VAR_SIZE-1);
+	}else{
+		for(i=0;i<EVENT_SIZE;i++){
+			EventTime1[i] = 0L;
+			EventTime2[i] = 0L;
+			EventCode[i] = 0;
+			EventData1[i] = 0;
+			EventData2[i] = 0.0;
+			EventTicks[i] = 0;
+			EventCrc[i] = EventSum(i);
+		}
+		EventIndex = 0;
+		EventTotal = 0L;
+		ClearStats();
+		EventBad = 0;
+		EventBadFirst = -1;
+		EventTickLast = 0;
+	}
+	EventQHead = 0;
+	EventQTail = 0;
+	EventQLost = 0;
+	EventSyncLast = 0;
+	if(!EventWarm || !EventVarValid()){
+		EventVarHead = 0;
+		EventVarTail = 0;
 	}
-	EventIndex = 0;
+	WarmSealEvents();
+
+	// Hold a frozen capture only if it was sealed and LogBuf still matches
+	LogHold = EventWarm && (WarmLogMagic==WARM_MAGIC) && (WarmLogCrc==WarmLogSum())
+		&& (WarmLogChan>0) && (WarmLogChan<=LOG_CHAN) && (WarmLogLength*WarmLogChan<=LOG_SIZE)
+		&& (WarmLogBufCrc==LogBufSum(WarmLogLength*WarmLogChan));
+	if(!LogHold) WarmLogMagic = 0;
+
+#if(EVENT_JOURNAL)
+	// Rebuild the most recent history from the non-volatile journal,
+	// a warm start already has it in RAM
+	InitJournal(!EventWarm);
+	// The replayed records carry the ticks of the run before, carry on
+	// past them as a warm start does or new events clamp to the old tick
+	if(!EventWarm && EventTotal!=0L){
+		LogTicks = (EventTickLast>>LOG_SUBTICK_BITS) + 1;
+	}
+#endif
 }
 
-/** Add an event to the log with some optional data */
-void LogEvent(int Code, int Data1, float Data2){
+/** Bring the warm start event header up to date */
+#pragma CODE_SECTION(WarmSealEvents, "ramfuncs")
+void WarmSealEvents(void){
 
-	long i1;
-	long i2;
-	TimeStamp(&i1,&i2);
+	WarmMagic = WARM_MAGIC;
+	WarmEventIndex = EventIndex;
+	WarmEventTotal = EventTotal;
+	WarmEventVarHead = EventVarHead;
+	WarmEventVarTail = EventVarTail;
+	WarmEventCrc = WarmEventSum();
+}
+
+/** Seal a frozen datalog capture for warm start, call from the background loop.
+ *  The CRC over LogBuf is taken once after the capture stops, and the seal
+ *  is dropped as soon as recording starts again. */
+void UpdateWarm(void){
+
+	int i;
+
+	if(LogHold) return;
+
+	if(LogTrigger!=0){
+		WarmLogMagic = 0;
+	}else if(WarmLogMagic!=WARM_MAGIC && LogHdrSamples!=0L){
+		WarmLogChan = LogChan;
+		WarmLogLength = LogLength;
+		WarmLogCount = LogCount;
+		WarmLogSamples = LogHdrSamples;
+		WarmLogPeriod = LogHdrPeriod;
+		for(i=0;i<LOG_CHAN;i++){
+			WarmLogAddr[i] = LogHdrAddr[i];
+		}
+		WarmLogQ15 = 0;
+		for(i=0;i<LOG_CHAN;i++){
+			if(LogHdrType[i]==LOG_Q15) WarmLogQ15 |= 1U<<i;
+		}
+		WarmLogBufCrc = LogBufSum(LogLength*LogChan);
+		WarmLogMagic = WARM_MAGIC;
+		WarmLogCrc = WarmLogSum();
+	}
+}
+
+/** Read the monotonic 64-bit timestamp.
+ *  Upper bits count ISR passes, the low LOG_SUBTICK_BITS hold the fraction
+ *  of the current ISR period.  Rereads if the ISR ticked part way through. */
+#pragma CODE_SECTION(LogTickNow, "ramfuncs")
+unsigned long long LogTickNow(void){
+
+	unsigned long long t;
+	unsigned long long sub;
 
-	EventTime1[EventIndex] = i1;
-	EventTime2[EventIndex] = i2;
+	do{
+		t = LogTicks;
+		sub = LOG_SUBTICK();
+	}while(t!=LogTicks);
+
+	return (t<<LOG_SUBTICK_BITS) | sub;
+}
+
+/** Write one record into the event log ring */
+void WriteEvent(unsigned long long Tick, long Time1, long Time2, int Code, int Data1, float Data2){
+
+	// A background read can trail a fresh ISR post by a fraction of a tick,
+	// never let the log step backwards
+	if(Tick<EventTickLast) Tick = EventTickLast;
+	EventTickLast = Tick;
+
+	EventTicks[EventIndex] = Tick;
+	EventTime1[EventIndex] = Time1;
+	EventTime2[EventIndex] = Time2;
 	EventCode[EventIndex] = Code;
 	EventData1[EventIndex] = Data1;
 	EventData2[EventIndex] = Data2;
+#if(EVENT_CRC)
+	EventCrc[EventIndex] = EventSum(EventIndex);	// last, a torn write will not match
+#endif
 	EventIndex++;
 	if(EventIndex==EVENT_SIZE) EventIndex = 0;
+	EventTotal++;
+	WarmSealEvents();
+
+}
+
+/** Add an event to the log with some optional data.
+ *  Call from the background loop only, ISR code uses PostEvent.
+ *  Anything still staged is committed first to keep the log in order. */
+void LogEvent(int Code, int Data1, float Data2){
+
+	long i1;
+	long i2;
+	unsigned long long t;
+
+	if(!EVENT_ENABLED(Code)) return;
+	CountEvent(Code,Data2,1);
+
+	CommitEvents();
+	t = LogTickNow();
+	TimeStamp(&i1,&i2);
+	WriteEvent(t,i1,i2,Code,Data1,Data2);
+
+}
+
+/** Fast ISR-safe event post.
+ *  Stores the raw LogTickNow timestamp with the code and data in the staging queue,
+ *  the TimeStamp conversion and the write to the log are left to
+ *  CommitEvents in the background.  When the queue is full the new
+ *  event is dropped and counted in EventQLost. */
+#pragma CODE_SECTION(PostEvent, "ramfuncs")
+void PostEvent(int Code, int Data1, float Data2){
+
+	unsigned int s;
+	int i;
+	int next;
+
+	if(!EVENT_ENABLED(Code)) return;
+	CountEvent(Code,Data2,1);
+
+	s = EVENT_LOCK();
+	i = EventQHead;
+	next = (i+1) & (EVENT_QSIZE-1);
+	if(next==EventQTail){
+		EventQLost++;
+	}else{
+		EventQTick[i] = LogTickNow();
+		EventQCode[i] = Code;
+		EventQData1[i] = Data1;
+		EventQData2[i] = Data2;
+		EventQHead = next;
+	}
+	EVENT_UNLOCK(s);
+
+}
+
+/** Move staged events into the event log, call from the background loop.
+ *  One TimeStamp is taken per pass and each event is dated back by its
+ *  age in ISR ticks. */
+void CommitEvents(void){
+
+	long i1;
+	long i2;
+	long t1;
+	long t2;
+	long borrow;
+	unsigned long long now;
+	int i;
+
+	if(EventQTail==EventQHead) return;
+
+	now = LogTickNow();
+	TimeStamp(&i1,&i2);
+
+	while(EventQTail!=EventQHead){
+		i = EventQTail;
+		t1 = i1;
+		t2 = i2 - (long)((now - EventQTick[i])>>LOG_SUBTICK_BITS) * TIME2_PER_TICK;
+		if(t2<0){
+			borrow = (TIME2_WRAP - 1 - t2) / TIME2_WRAP;
+			t2 = t2 + borrow * TIME2_WRAP;
+			t1 = t1 - borrow;
+		}
+		WriteEvent(EventQTick[i],t1,t2,EventQCode[i],EventQData1[i],EventQData2[i]);
+		EventQTail = (i+1) & (EVENT_QSIZE-1);
+	}
+
+}
+
+/** Periodic timestamp sync record, call from the background loop.
+ *  Each E_SYNC event pairs a TimeStamp wall clock with the 64-bit tick,
+ *  Data1 holds LOG_SUBTICK_BITS.  The host interpolates between sync
+ *  records to turn event and datalog ticks into absolute time. */
+void SyncEvents(void){
+
+	unsigned long long t;
+
+	if(EventSyncPeriod<=0L) return;
+
+	t = LogTickNow();
+	if(((t - EventSyncLast)>>LOG_SUBTICK_BITS) >= (unsigned long long)EventSyncPeriod){
+		EventSyncLast = t;
+		LOG_EVENT(E_SYNC,LOG_SUBTICK_BITS,0.0);
+	}
+
+}
+
+// Payload types of the variable length records, indexed by event code.
+// 'i' int, one word.  'l' long, two words high first.  'f' float bits, two
+// words high first.  An empty string means the code has no variable form.
+const char * const EventSchema[EVENT_CODES] = {
+	"",			// 0
+	"",			// E_START
+	"",			// E_STOP
+	"",			// E_RESET
+	"",			// E_FORCE
+	"",			// E_STATE
+	"iff",		// E_PARAM, parameter id, old value, new value
+	"",			// E_FAULT
+	"",			// E_DATALOG
+	"",			// E_SETPOINT
+	"iil",		// E_FLASH, operation, parameters loaded, checksum
+	"",			// E_CANBAD
+	"",			// E_SYNC
+	""			// E_REACT
+};
+
+/** Add a variable length record to EventVar, call from the background loop.
+ *  Record layout in 16-bit words: a header word (Code<<8 | length in words),
+ *  the four words of LogTickNow high first, then n payload words laid out as
+ *  EventSchema[Code].  The oldest records are dropped to make room, a
+ *  header with a length no record can have empties the ring instead.  The
+ *  ring is sealed into the warm start header once the room is made and
+ *  again after the record, so a reset in between keeps the older records.
+ *  The fixed size log is still the fast path for events with one int and
+ *  one float. */
+void LogEventWords(int Code, const unsigned int *w, int n){
+
+	unsigned long long t;
+	unsigned int rec[5];
+	int len;
+	int used;
+	int i;
+
+	len = n + 5;
+	if(n<0 || len>255 || len>EVENT_VAR_SIZE-1) return;
+	if(!EVENT_ENABLED(Code)) return;
+	CountEvent(Code,0.0,0);
+
+	CommitEvents();
+	t = LogTickNow();
+	rec[0] = ((unsigned int)(Code&0xFF)<<8) | (unsigned int)len;
+	rec[1] = (unsigned int)(t>>48) & 0xFFFF;
+	rec[2] = (unsigned int)(t>>32) & 0xFFFF;
+	rec[3] = (unsigned int)(t>>16) & 0xFFFF;
+	rec[4] = (unsigned int)t & 0xFFFF;
+
+	// Drop whole records from the tail until the new one fits
+	used = (EventVarHead - EventVarTail) & (EVENT_VAR_SIZE-1);
+	while(EVENT_VAR_SIZE-1-used < len){
+		i = (int)(EventVar[EventVarTail] & 0xFF);
+		if(i<5 || i>used){
+			EventVarTail = EventVarHead;
+			used = 0;
+		}else{
+			EventVarTail = (EventVarTail + i) & (EVENT_VAR_SIZE-1);
+			used = used - i;
+		}
+	}
+	WarmSealEvents();
+
+	for(i=0;i<5;i++){
+		EventVar[EventVarHead] = rec[i];
+		EventVarHead = (EventVarHead+1) & (EVENT_VAR_SIZE-1);
+	}
+	for(i=0;i<n;i++){
+		EventVar[EventVarHead] = w[i] & 0xFFFF;
+		EventVarHead = (EventVarHead+1) & (EVENT_VAR_SIZE-1);
+	}
+	WarmSealEvents();
+}
+
+/** Log a parameter change with its id and the old and new values */
+void LogParam(int id, float old, float value){
+
+	union { float f; unsigned long l; } a, b;
+	unsigned int w[5];
+
+	a.f = old;
+	b.f = value;
+	w[0] = (unsigned int)id & 0xFFFF;
+	w[1] = (unsigned int)(a.l>>16) & 0xFFFF;
+	w[2] = (unsigned int)a.l & 0xFFFF;
+	w[3] = (unsigned int)(b.l>>16) & 0xFFFF;
+	w[4] = (unsigned int)b.l & 0xFFFF;
+	LogEventWords(E_PARAM,w,5);
+}
 
+/** Log a flash parameter operation, what was loaded and its checksum */
+void LogFlash(int op, int count, long sum){
+
+	unsigned int w[4];
+
+	w[0] = (unsigned int)op & 0xFFFF;
+	w[1] = (unsigned int)count & 0xFFFF;
+	w[2] = (unsigned int)((unsigned long)sum>>16) & 0xFFFF;
+	w[3] = (unsigned int)sum & 0xFFFF;
+	LogEventWords(E_FLASH,w,4);
 }
 
-/** Setup default data logging */
+/** Setup default data logging
+ *  1 motor signals
+ *  2 on-times of each SvmInst, three channels per instance, LOG_Q15
+ *    when the modulator is built with SVM_IQ */
 void DefaultLog(int i){
 
+	LogAddr_t * const addr[LOG_CHAN] = {
+		&LogAddr0, &LogAddr1, &LogAddr2, &LogAddr3, &LogAddr4,
+		&LogAddr5, &LogAddr6, &LogAddr7, &LogAddr8
+	};
+	int n;
+	int k;
+
 	switch(i){
 	case 1:
-		LogAddr0 = (int)&IdRef;
-		LogAddr1 = (int)&IqRef;
-		LogAddr2 = (int)&RpmRef;
-		LogAddr3 = (int)&Id;
-		LogAddr4 = (int)&Iq;
-		LogAddr5 = (int)&RpmOut;
-		LogAddr6 = (int)&VdRef;
-		LogAddr7 = (int)&VqRef;
-		LogAddr8 = (int)&ThetaOut;
+		LogAddr0 = (LogAddr_t)&IdRef;
+		LogAddr1 = (LogAddr_t)&IqRef;
+		LogAddr2 = (LogAddr_t)&RpmRef;
+		LogAddr3 = (LogAddr_t)&Id;
+		LogAddr4 = (LogAddr_t)&Iq;
+		LogAddr5 = (LogAddr_t)&RpmOut;
+		LogAddr6 = (LogAddr_t)&VdRef;
+		LogAddr7 = (LogAddr_t)&VqRef;
+		LogAddr8 = (LogAddr_t)&ThetaOut;
 		LogChan = 9;
+		LogQ15 = 0;
 		LogSingle = 0;
 		LogSkip = 20;
 		LogAuto = 1;
 		LogInit = 1;
 		break;
+	case 2:
+		n = 0;
+		for(k=0;k<SVM_INSTANCES && n+3<=LOG_CHAN;k++){
+			*addr[n++] = (LogAddr_t)&SvmInst[k].Out.OnA;
+			*addr[n++] = (LogAddr_t)&SvmInst[k].Out.OnB;
+			*addr[n++] = (LogAddr_t)&SvmInst[k].Out.OnC;
+		}
+		LogChan = n;
+		LogQ15 = SVM_IQ ? (1<<n) - 1 : 0;
+		LogSingle = 0;
+		LogSkip = 0;
+		LogAuto = 1;
+		LogInit = 1;
+		break;
 
 	}
 
@@ -178,6 +1019,25 @@ void InitLog(void){
 
 	int i;
 
+	// A capture kept over a soft reset keeps its layout until released
+	if(LogHold){
+		LogTrigger = 0;
+		LogInit = 0;
+		LogChan = WarmLogChan;
+		LogLength = WarmLogLength;
+		LogCount = WarmLogCount;
+		for(i=0;i<LogChan;i++){
+			LogBase[i] = LogBuf + i*LogLength;
+		}
+		for(i=0;i<LOG_CHAN;i++){
+			LogHdrAddr[i] = WarmLogAddr[i];
+			LogHdrType[i] = ((WarmLogQ15>>i) & 1) ? LOG_Q15 : LOG_FLOAT;
+		}
+		LogHdrSamples = WarmLogSamples;
+		LogHdrPeriod = WarmLogPeriod;
+		return;
+	}
+
 	LogTrigger = 0;
 	LogLength = LOG_SIZE / LogChan;
 	for(i=0;i<LogChan;i++){
@@ -186,15 +1046,46 @@ void InitLog(void){
 	LogInit=0;
 	LogCount=0;
 	LogSkipCount=0;
-	LogPtr[0]=(float *)(LogAddr0&0x0000FFFF);
-	LogPtr[1]=(float *)(LogAddr1&0x0000FFFF);
-	LogPtr[2]=(float *)(LogAddr2&0x0000FFFF);
-	LogPtr[3]=(float *)(LogAddr3&0x0000FFFF);
-	LogPtr[4]=(float *)(LogAddr4&0x0000FFFF);
-	LogPtr[5]=(float *)(LogAddr5&0x0000FFFF);
-	LogPtr[6]=(float *)(LogAddr6&0x0000FFFF);
-	LogPtr[7]=(float *)(LogAddr7&0x0000FFFF);
-	LogPtr[8]=(float *)(LogAddr8&0x0000FFFF);
+	LogPtr[0]=(float *)(LogAddr0&LOG_ADDR_MASK);
+	LogPtr[1]=(float *)(LogAddr1&LOG_ADDR_MASK);
+	LogPtr[2]=(float *)(LogAddr2&LOG_ADDR_MASK);
+	LogPtr[3]=(float *)(LogAddr3&LOG_ADDR_MASK);
+	LogPtr[4]=(float *)(LogAddr4&LOG_ADDR_MASK);
+	LogPtr[5]=(float *)(LogAddr5&LOG_ADDR_MASK);
+	LogPtr[6]=(float *)(LogAddr6&LOG_ADDR_MASK);
+	LogPtr[7]=(float *)(LogAddr7&LOG_ADDR_MASK);
+	LogPtr[8]=(float *)(LogAddr8&LOG_ADDR_MASK);
+
+	// Start a new capture header, a sample is moved as a 32-bit word so a
+	// LogQ15 channel keeps the bits of its _iq15
+	for(i=0;i<LOG_CHAN;i++){
+		LogHdrAddr[i] = (i<LogChan) ? (LogAddr_t)LogPtr[i] : 0;
+		LogHdrType[i] = ((LogQ15>>i) & 1) ? LOG_Q15 : LOG_FLOAT;
+	}
+	for(i=0;i<LOG_MARKS;i++){
+		LogMarkSample[i] = 0L;
+		LogMarkTick[i] = 0;
+		LogMarkPeriod[i] = 0;
+	}
+	LogHdrStart = 0;
+	LogHdrSamples = 0L;
+	LogHdrPeriod = LogSkip + 1;
+	LogHdrTrigger = 0;
+	LogHdrTrigTick = 0;
+	LogMarkIndex = 0;
+	LogMarkCount = LOG_MARK_EVERY;
+}
+
+/** Add a timestamp marker for the sample about to be recorded */
+#pragma CODE_SECTION(LogMark, "ramfuncs")
+static void LogMark(unsigned long long tick){
+
+	LogMarkSample[LogMarkIndex] = LogHdrSamples;
+	LogMarkTick[LogMarkIndex] = tick;
+	LogMarkPeriod[LogMarkIndex] = LogHdrPeriod;
+	LogMarkIndex++;
+	if(LogMarkIndex==LOG_MARKS) LogMarkIndex = 0;
+	LogMarkCount = LOG_MARK_EVERY;
 }
 
 	/** Update the log state, includes resets and triggering */
@@ -203,9 +1094,13 @@ void UpdateLog(void){
 
 	int i;
 
+	LogTicks++;
+
 	// Make eventlog entry if trigger has changed
 	if(LogTrigger!=OldTrigger){
-		LogEvent(E_DATALOG,LogTrigger,LogSkip);
+		POST_EVENT(E_DATALOG,LogTrigger,LogSkip);
+		LogHdrTrigger = LogCount;
+		LogHdrTrigTick = LogTickNow();
 	}
 	OldTrigger=LogTrigger;
 
@@ -213,11 +1108,24 @@ void UpdateLog(void){
 	if(LogInit!=0) InitLog();
 
 	// Record data when LogTrigger is non-zero
-	if(LogTrigger != 0){
+	if(LogTrigger != 0 && LogHold == 0){
 		if(LogSkipCount<LogSkip){
 			LogSkipCount++;
 		}else{
 			LogSkipCount=0;
+			// Keep the capture header exact, mark the first sample, any
+			// change of LogSkip, and every LOG_MARK_EVERY samples
+			if(LogHdrSamples==0L){
+				LogHdrStart = LogTickNow();
+				LogHdrPeriod = LogSkip + 1;
+				LogMark(LogHdrStart);
+			}else if(LogHdrPeriod!=LogSkip+1){
+				LogMark(LogTickNow());
+				LogHdrPeriod = LogSkip + 1;
+			}else if(LOG_MARK_EVERY>0 && --LogMarkCount<=0){
+				LogMark(LogTickNow());
+			}
+			LogHdrSamples++;
 			// Record data
 			for(i=0;i<LogChan;i++){
 				LogBase[i][LogCount] = *(LogPtr[i]);
@@ -20,6 +20,53 @@
 #define E_SETPOINT 9	/**< Speed setpoint changed */
 #define E_FLASH 10		/**< Load, Save, Default Params */
 #define E_CANBAD 11		/**< CANbus error occurred */
+#define E_SYNC 12		/**< Timestamp sync, wall clock paired with 64-bit tick */
+#define E_REACT 13		/**< Fault reaction taken, Data1 class, Data2 fault code */
+#define EVENT_CODES 14	/**< Number of event codes, size of the per-code tables */
+#if(EVENT_CODES > 32)
+#error "EVENT_CODES must fit the 32 bits of EventMask"
+#endif
+
+// Multi-inverter boards tag an event code with the instance that raised it,
+// EVENT_INST(E_FAULT,1).  The tag sits above the code bits in EventCode and
+// in the variable record header, untagged codes belong to instance 0.
+#define EVENT_INST_SHIFT	6		/**< Events, bit position of the instance tag */
+#define EVENT_CODE_MASK		0x3F	/**< Events, code bits of a tagged code */
+#define EVENT_INSTANCES		4		/**< Events, instances the tag can carry */
+#define EVENT_INST(code,inst)	((code) | ((inst)<<EVENT_INST_SHIFT))	/**< Events, tag code with an instance */
+#define EVENT_INST_OF(code)		(((code)>>EVENT_INST_SHIFT) & (EVENT_INSTANCES-1))	/**< Events, instance of a tagged code */
+
+// Event verbosity.  A call written with POST_EVENT or LOG_EVENT is compiled
+// in only when the level of its code is at or below EVENT_LEVEL, so a lean
+// field build drops the noisy calls from ramfuncs altogether.  At runtime
+// EventMask turns single codes on and off with one bit test.
+#define EL_ESSENTIAL	0		/**< Faults and state changes, always built */
+#define EL_NORMAL		1		/**< Commands and configuration */
+#define EL_VERBOSE		2		/**< High rate diagnostics */
+#ifndef EVENT_LEVEL
+#define EVENT_LEVEL		EL_VERBOSE	/**< Events, highest level compiled in */
+#endif
+#define E_START_LEVEL		EL_NORMAL
+#define E_STOP_LEVEL		EL_NORMAL
+#define E_RESET_LEVEL		EL_NORMAL
+#define E_FORCE_LEVEL		EL_NORMAL
+#define E_STATE_LEVEL		EL_ESSENTIAL
+#define E_PARAM_LEVEL		EL_NORMAL
+#define E_FAULT_LEVEL		EL_ESSENTIAL
+#define E_DATALOG_LEVEL		EL_VERBOSE
+#define E_SETPOINT_LEVEL	EL_VERBOSE
+#define E_FLASH_LEVEL		EL_NORMAL
+#define E_CANBAD_LEVEL		EL_NORMAL
+#define E_SYNC_LEVEL		EL_NORMAL
+#define E_REACT_LEVEL		EL_ESSENTIAL
+
+#define EVENT_ENABLED(code)	((EventMask & (1UL<<((code)&EVENT_CODE_MASK))) != 0UL)
+#define POST_EVENT(code,d1,d2)	do{ if(code##_LEVEL <= EVENT_LEVEL) PostEvent(code,d1,d2); }while(0)
+#define LOG_EVENT(code,d1,d2)	do{ if(code##_LEVEL <= EVENT_LEVEL) LogEvent(code,d1,d2); }while(0)
+#define POST_EVENT_INST(code,inst,d1,d2)	do{ if(code##_LEVEL <= EVENT_LEVEL) PostEvent(EVENT_INST(code,inst),d1,d2); }while(0)
+#define LOG_EVENT_INST(code,inst,d1,d2)	do{ if(code##_LEVEL <= EVENT_LEVEL) LogEvent(EVENT_INST(code,inst),d1,d2); }while(0)
+
+extern unsigned long EventMask;
 
 #if(0)
 // Definitions for fault codes, use powers of 2 for bit bashing
@@ -60,4 +107,243 @@
 #define F_STALL			16  	/**< Stall Protection */
 #endif
 
+// Fault registry, holds FAULT_COUNT codes whatever the width of a long
+#ifndef FAULT_COUNT
+#define FAULT_COUNT		32		/**< Faults, number of fault codes, raise when adding codes */
+#endif
+#define FAULT_WORDS		((FAULT_COUNT+31)/32)	/**< Faults, 32-bit words in the bitset */
+
+// Fault reaction classes for the policy table FaultClass, most severe first
+#define FC_DISABLE		0		/**< Disable PWM at once and enter FAULT */
+#define FC_RAMP			1		/**< Zero the speed reference, ramp down with PWM on */
+#define FC_DERATE		2		/**< Keep running with limits scaled by FaultDerate */
+#define FC_WARN			3		/**< Log only */
+#define FC_CLASSES		4		/**< Number of reaction classes */
+
+// Reaction state read by the control loops, which scale their output
+// limits by FaultDerate and keep WeRef at zero while FaultRamp is set
+extern float FaultDerate;
+extern float FaultDerateLevel;
+extern int FaultRamp;
+
+void Fault(long fcode, float data2);
+void FaultConfirmed(long fcode, float data2);
+void ResetFaults(void);
+int FaultActive(int fcode);
+int FaultNext(int fcode);
+
+// Fault detection limits, see Faults.c
+#ifndef FAULT_LIMITS
+#define FAULT_LIMITS	24		/**< Fault detect, size of the limit table */
+#endif
+
+typedef struct {
+	float *Signal;		/**< Signal to watch */
+	float Sign;			/**< 1.0 for a high limit, -1.0 for a low limit */
+	float Trip;			/**< Trip level times Sign */
+	float Clear;		/**< Clear level times Sign */
+	int Limit;			/**< ISR passes over Trip to confirm */
+	int Code;			/**< Fault code passed to Fault */
+} FaultLimit;
+
+int AddFaultLimit(float *signal, float trip, float clear, int limit, int code);
+void ResetFaultLimits(void);
+void UpdateFaults(void);
+
+// Per-code counters and optional log-scale histograms of Data2.  They do
+// not depend on the ring, and the block reads out in one transfer.
+#ifndef EVENT_HIST
+#define EVENT_HIST			1		/**< Events, 1 to keep histograms */
+#endif
+#ifndef EVENT_HIST_BINS
+#define EVENT_HIST_BINS		16		/**< Events, histogram bins, factor 2 apart */
+#endif
+#ifndef EVENT_HIST_MIN_EXP
+#define EVENT_HIST_MIN_EXP	(-4)	/**< Events, bin 1 starts at 2^EVENT_HIST_MIN_EXP */
+#endif
+
+typedef struct {
+	unsigned long EventCount[EVENT_CODES];	/**< Occurrences of each event code */
+	unsigned long FaultCount[FAULT_COUNT];	/**< Occurrences of each fault code */
+#if(EVENT_HIST)
+	unsigned int EventHist[EVENT_CODES][EVENT_HIST_BINS];	/**< |Data2| per event code */
+	unsigned int FaultHist[FAULT_COUNT][EVENT_HIST_BINS];	/**< |data2| per fault code */
+#endif
+} LogStatsBlock;
+
+// LogStatsBlock in 16-bit words as it is laid out on the DSP and on the wire
+#if(EVENT_HIST)
+#define LOG_STATS_WORDS	(2*(EVENT_CODES+FAULT_COUNT) + (EVENT_CODES+FAULT_COUNT)*EVENT_HIST_BINS)
+#else
+#define LOG_STATS_WORDS	(2*(EVENT_CODES+FAULT_COUNT))
+#endif
+
+extern LogStatsBlock LogStats;
+void ClearStats(void);
+
+// Log block transfer over CANbus, see LogXfer.c
+#ifndef XFER_RX_ID
+#define XFER_RX_ID		0x610	/**< Xfer, CAN id of host commands */
+#endif
+#ifndef XFER_TX_ID
+#define XFER_TX_ID		0x611	/**< Xfer, CAN id of data frames */
+#endif
+#ifndef XFER_WINDOW
+#define XFER_WINDOW		32		/**< Xfer, default frames in flight */
+#endif
+#ifndef XFER_TIMEOUT
+#define XFER_TIMEOUT	2000L	/**< Xfer, default ISR ticks without progress before resending */
+#endif
+#ifndef XFER_QSIZE
+#define XFER_QSIZE		16		/**< Xfer, command queue length, must be a power of 2 */
+#endif
+#define XFER_START		1		/**< Xfer command, start a region transfer */
+#define XFER_ACK		2		/**< Xfer command, cumulative acknowledge */
+#define XFER_STOP		3		/**< Xfer command, abandon the transfer */
+#define XFER_SET		4		/**< Xfer command, write a setting */
+#define XFER_GET		5		/**< Xfer command, read a setting */
+#define XFER_RESET		6		/**< Xfer command, ResetFaults */
+#define XFER_REPLY		0xFFFF	/**< Xfer, word 0 of a reply frame, never a sequence number */
+#define XFER_REJECT		0x100	/**< Xfer, added to the setting of the reply to a refused XFER_SET */
+#define XFER_V_TRIGGER		0	/**< Xfer setting, LogTrigger */
+#define XFER_V_INIT			1	/**< Xfer setting, LogInit */
+#define XFER_V_CHAN			2	/**< Xfer setting, LogChan */
+#define XFER_V_SKIP			3	/**< Xfer setting, LogSkip */
+#define XFER_V_SINGLE		4	/**< Xfer setting, LogSingle */
+#define XFER_V_AUTO			5	/**< Xfer setting, LogAuto */
+#define XFER_V_HOLD			6	/**< Xfer setting, LogHold */
+#define XFER_V_ADDR0		7	/**< Xfer setting, LogAddr0, LogAddr1 to 8 follow */
+#define XFER_V_Q15			16	/**< Xfer setting, LogQ15 */
+#define XFER_SETTINGS		17	/**< Xfer, number of settings */
+#define XFER_R_LOGBUF		0	/**< Xfer region, LogBuf */
+#define XFER_R_TIME1		1	/**< Xfer region, EventTime1 */
+#define XFER_R_TIME2		2	/**< Xfer region, EventTime2 */
+#define XFER_R_CODE			3	/**< Xfer region, EventCode */
+#define XFER_R_DATA1		4	/**< Xfer region, EventData1 */
+#define XFER_R_DATA2		5	/**< Xfer region, EventData2 */
+#define XFER_R_TICKS		6	/**< Xfer region, EventTicks */
+#define XFER_R_CRC			7	/**< Xfer region, EventCrc */
+#define XFER_R_VAR			8	/**< Xfer region, EventVar */
+#define XFER_R_STATS		9	/**< Xfer region, LogStats */
+#define XFER_R_INDEX		10	/**< Xfer region, log positions and capture header, see below */
+#define XFER_REGIONS		11	/**< Xfer, number of regions */
+
+// XFER_R_INDEX, target words in this order, longs and ticks low word first:
+// EventIndex, EventTotal (2), EventVarHead, EventVarTail, EventVarSize,
+// LogLength, LogCount, LogHdrStart (4), LogHdrSamples (2), LogHdrPeriod,
+// LogHdrTrigger, LogHdrTrigTick (4), LogHdrAddr (2 each), LogHdrType,
+// LogMarkIndex, LogMarkSample (2 each), LogMarkTick (4 each), LogMarkPeriod
+#define XFER_INDEX_WORDS	(21 + 3*LOG_CHAN + 7*LOG_MARKS)	/**< Xfer, words of XFER_R_INDEX */
+
+// Board support for the transfer, the host build provides its own
+int CanTxFree(void);
+void CanTxFrame(unsigned int id, const unsigned short *w);
+
+void XferReceive(const unsigned short *w);
+void UpdateXfer(void);
+#ifdef HOST_SIM
+int XferHostOpen(const char *name);
+void XferHostClose(void);
+void XferHostPoll(void);
+#endif
+
+// Data log channel addresses are kept as CANbus readable integers.  On the DSP
+// a data address fits in 16 bits, a host simulation (HOST_SIM) needs the full
+// pointer width so the same Logs.c can run on a PC.  LogXfer.c sends those as
+// 32-bit offsets from &LogAddr0.
+#ifdef HOST_SIM
+typedef long LogAddr_t;
+#define LOG_ADDR_MASK	(~0L)
+#else
+typedef int LogAddr_t;
+#define LOG_ADDR_MASK	0x0000FFFF
+#endif
+
+// Events posted from the ISR wait in a staging queue until the background
+// commits them, TimeStamp part 2 is assumed to count up in ISR ticks
+#ifndef EVENT_QSIZE
+#define EVENT_QSIZE		16		/**< Events, staging queue length, must be a power of 2 */
+#endif
+#ifndef TIME2_PER_TICK
+#define TIME2_PER_TICK	1L		/**< Events, TimeStamp part 2 counts per ISR tick */
+#endif
+#ifndef TIME2_WRAP
+#define TIME2_WRAP		10000L	/**< Events, TimeStamp part 2 count that carries into part 1 */
+#endif
+
+// Event timestamps count ISR passes in the upper bits and a fraction of the
+// ISR period in the low LOG_SUBTICK_BITS.  LOG_SUBTICK() reads that fraction
+// from a free running hardware counter, it must return 0..2^LOG_SUBTICK_BITS-1.
+#ifndef LOG_SUBTICK_BITS
+#define LOG_SUBTICK_BITS	0
+#endif
+#ifndef LOG_SUBTICK
+#define LOG_SUBTICK()		0
+#endif
+
+// Datalog capture header channel types and sparse timestamp markers
+#define LOG_FLOAT		1		/**< Log, channel records a float */
+#define LOG_Q15			2		/**< Log, channel records the raw bits of an _iq15 long, value/32768 */
+#ifndef LOG_MARKS
+#define LOG_MARKS		8		/**< Log, number of timestamp markers kept */
+#endif
+#ifndef LOG_MARK_EVERY
+#define LOG_MARK_EVERY	0		/**< Log, samples between optional sparse markers, 0 to mark only start and LogSkip changes */
+#endif
+
+// Non-volatile event journal, see Journal.c
+#ifndef EVENT_JOURNAL
+#define EVENT_JOURNAL		0		/**< Events, 1 to journal the event log to flash/FRAM */
+#endif
+#ifndef JOURNAL_SECTORS
+#define JOURNAL_SECTORS		4		/**< Journal, number of erase sectors used in rotation */
+#endif
+#ifndef JOURNAL_SECTOR_WORDS
+#define JOURNAL_SECTOR_WORDS	2048L	/**< Journal, 16-bit words per erase sector */
+#endif
+#ifndef JOURNAL_RESTORE
+#define JOURNAL_RESTORE		32		/**< Journal, events rebuilt into the log at startup */
+#endif
+#ifndef JOURNAL_PER_PASS
+#define JOURNAL_PER_PASS	4		/**< Journal, most records written per UpdateJournal call */
+#endif
+#define JOURNAL_REC_WORDS	16		/**< Journal, words per record */
+#define JOURNAL_MAGIC		0xA55A	/**< Journal, last word of a complete record */
+#define NV_ERASED			0xFFFF	/**< Journal, value of an erased word */
+
+// Board support for the journal store, word addresses start at 0
+void NvRead(long addr, unsigned int *buf, int n);
+void NvWrite(long addr, const unsigned int *buf, int n);
+void NvErase(int sector);
+
+void InitJournal(int restore);
+void UpdateJournal(void);
+void WriteEvent(unsigned long long Tick, long Time1, long Time2, int Code, int Data1, float Data2);
+
+// Variable length event records
+#ifndef EVENT_VAR_SIZE
+#define EVENT_VAR_SIZE	256		/**< Events, words in the variable record ring, must be a power of 2 */
+#endif
+
+void LogEventWords(int Code, const unsigned int *w, int n);
+void LogParam(int id, float old, float value);
+void LogFlash(int op, int count, long sum);
+
+void PostEvent(int Code, int Data1, float Data2);
+void CommitEvents(void);
+unsigned long long LogTickNow(void);
+void SyncEvents(void);
+
+// Warm start, the "Events" section keeps the log over a soft reset
+#define WARM_MAGIC		0x5AA5	/**< Warm start, marks a valid header */
+#ifndef EVENT_CRC
+#define EVENT_CRC		1		/**< Events, 1 to store a CRC with every record, see CheckEvents */
+#endif
+
+unsigned int LogCrc(unsigned int crc, unsigned int w);
+unsigned int LogCrcLong(unsigned int crc, unsigned long l);
+int CheckEvents(void);
+void WarmSealEvents(void);
+void UpdateWarm(void);
+
 #endif /* LOGS_H_ */
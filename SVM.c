@@ -1,235 +1,563 @@
 
+#include "Setup.h"     // DSP2833x Headerfile Include File
+#include "SVM.h"
+
+SvmInstance SvmInst[SVM_INSTANCES];	/**< Svm, modulator state of each inverter */
+float SvmClampOn = 0.75;	/**< Svm, |Vref| above which SVM_AUTO bus clamps */
+float SvmClampOff = 0.65;	/**< Svm, |Vref| below which SVM_AUTO returns to symmetric */
+float SvmPsi = 0.5235988;	/**< Svm, clamp boundary of SVM_DPWM in radians, 0 to pi/3 */
+int SvmOverMod = 0;			/**< Svm, 1 for overmodulation modes I and II, 0 to clip */
+int SvmDtcMode = SVM_DTC_OFF;	/**< Svm, deadtime compensation source, SVM_DTC_* */
+float SvmDtcBand = 0.1;		/**< Svm, current where the deadtime compensation reaches SvmDtc */
+float SvmIAlpha = 0;		/**< Svm, reference current in alpha for SVM_DTC_REF */
+float SvmIBeta = 0;			/**< Svm, reference current in beta for SVM_DTC_REF */
+int SvmMinMode = SVM_MIN_OFF;	/**< Svm, narrow pulse handling, SVM_MIN_* */
+float SvmMinPulse = 0;		/**< Svm, shortest pulse in counts the gate driver takes */
+SvmCompare SvmCmp;			/**< Svm, compare values staged by UpdateSpaceVector */
+
+// The three compare writes go out with the interrupts held, so a higher
+// priority interrupt cannot stretch them across a period boundary
+#ifdef HOST_SIM
+#define SVM_LOCK()		0
+#define SVM_UNLOCK(s)	(void)(s)
+#else
+#define SVM_LOCK()		__disable_interrupts()
+#define SVM_UNLOCK(s)	__restore_interrupts(s)
+#endif
+
+// Active vector time of each phase by sector, index into {0, Tx, Ty, Tx+Ty}
+static const unsigned char SvmActive[7][3] = {
+	{0, 0, 0},		// no sector
+	{3, 2, 0},		// 1
+	{1, 3, 0},		// 2
+	{0, 3, 1},		// 3
+	{0, 1, 3},		// 4
+	{1, 0, 3},		// 5
+	{3, 0, 2}		// 6
+};
+
+// Active vector starting each sector, index into {0, Tx, Ty}
+static const unsigned char SvmStart[7] = {1, 1, 1, 2, 1, 2, 2};
+
+// Overmodulation tables, SVM_OM_POINTS steps of |Vref|^2, computed offline by
+// integrating the fundamental of the modulated trajectory over a sector.
+// Mode I, gain on Vref before the hexagon clip, |Vref|^2 from SVM_OM_LIN2
+// to SVM_OM_HEX2.
+static const svm_t SvmOmGain[SVM_OM_POINTS] = {
+	SVM_C(1.000000),
+	SVM_C(1.000374),
+	SVM_C(1.001141),
+	SVM_C(1.002235),
+	SVM_C(1.003650),
+	SVM_C(1.005398),
+	SVM_C(1.007504),
+	SVM_C(1.010005),
+	SVM_C(1.012953),
+	SVM_C(1.016419),
+	SVM_C(1.020507),
+	SVM_C(1.025365),
+	SVM_C(1.031228),
+	SVM_C(1.038489),
+	SVM_C(1.047925),
+	SVM_C(1.061548),
+	SVM_C(1.100605)
+};
+
+// Mode II, share of the hexagon side held at each vertex, |Vref|^2 from
+// SVM_OM_HEX2 to SVM_OM_SIX2.  0.5 is six-step.
+static const svm_t SvmOmHold[SVM_OM_POINTS] = {
+	SVM_C(0.000000),
+	SVM_C(0.018383),
+	SVM_C(0.037108),
+	SVM_C(0.056227),
+	SVM_C(0.075804),
+	SVM_C(0.095915),
+	SVM_C(0.116655),
+	SVM_C(0.138143),
+	SVM_C(0.160531),
+	SVM_C(0.184023),
+	SVM_C(0.208898),
+	SVM_C(0.235557),
+	SVM_C(0.264622),
+	SVM_C(0.297140),
+	SVM_C(0.335160),
+	SVM_C(0.383996),
+	SVM_C(0.500000)
+};
+
+/** Reciprocal of x > 0 without a divide, so the clip costs the same at
+ *  every operating point.  The FPU estimate EINVF32 is good to about 8 bits
+ *  and two Newton steps y = y*(2 - x*y) take it to full float precision.
+ *  Elsewhere the seed comes from the exponent bits, good to 12 percent,
+ *  and needs a third step.  Relative error below 3e-7 either way.  The
+ *  fixed point build keeps the IQmath divide, which is fixed cycle. */
+#if(SVM_IQ)
+#define SVM_RECIP(x)	SVM_DIV(SVM_C(1.0), (x))
+#else
+#define SVM_RECIP(x)	SvmRecip(x)
+#pragma CODE_SECTION(SvmRecip, "ramfuncs");
+static float SvmRecip(float x){
+
+	float y;
+
+#if defined(__TMS320C28XX_FPU32__)
+	y = __einvf32(x);
+#else
+	union { float f; unsigned long l; } u;
+
+	u.l = 0;
+	u.f = x;
+	u.l = (0x7EF311C3UL - (u.l & 0xFFFFFFFFUL)) & 0xFFFFFFFFUL;
+	y = u.f;
+	y = y*(2.0f - x*y);
+#endif
+	y = y*(2.0f - x*y);
+	y = y*(2.0f - x*y);
+	return y;
+}
+#endif
+
+/** Add the deadtime correction for phase current i to an on time and keep
+ *  it within the period.  The correction is dtc outside +/-band and i*g
+ *  inside.  Written as selects, no branches. */
+#pragma CODE_SECTION(SvmDeadtime, "ramfuncs");
+static svm_t SvmDeadtime(svm_t on, svm_t i, svm_t band, svm_t g, svm_t dtc, svm_t period){
+
+	svm_t d;
+
+	d = SVM_MPY(i,g);
+	d = (i>band) ? dtc : d;
+	d = (i<-band) ? -dtc : d;
+	on = on + d;
+	on = (on>period) ? period : on;
+	on = (on<0) ? 0 : on;
+	return on;
+}
+
+/** Keep one phase clear of pulses shorter than min, high or low.  The on
+ *  time owed from earlier periods is added first, and what this period
+ *  could not give is carried to the next, so the phase keeps its
+ *  volt-seconds on average.  drop picks the nearer of no pulse and min,
+ *  otherwise a narrow pulse is widened to min.  Selects only, constant
+ *  time. */
+#pragma CODE_SECTION(SvmPulse, "ramfuncs");
+static svm_t SvmPulse(svm_t on, svm_t *carry, svm_t min, svm_t period, int drop){
+
+	svm_t req;
+	svm_t hi;
+	svm_t c;
+
+	req = on + *carry;
+	hi = period - min;
+	on = req;
+	on = (req>0 && req<min) ? ((drop && 2*req<min) ? 0 : min) : on;
+	on = (req<period && req>hi) ? ((drop && 2*(period-req)<min) ? period : hi) : on;
+	on = (on<0) ? 0 : on;
+	on = (on>period) ? period : on;
+	c = req - on;
+	c = (c>min) ? min : c;
+	c = (c<-min) ? -min : c;
+	*carry = c;
+	return on;
+}
+
+/** Linear interpolation in an overmodulation table from x0, scale is
+ *  table steps per unit of x */
+#pragma CODE_SECTION(SvmOmTable, "ramfuncs");
+static svm_t SvmOmTable(const svm_t *tbl, svm_t x, svm_t x0, svm_t scale){
+
+	svm_t f;
+	int i;
+
+	f = SVM_MPY(x - x0, scale);
+	if(f<0) f = 0;
+	i = SVM_TOI(f);
+	if(i>SVM_OM_POINTS-2) i = SVM_OM_POINTS-2;
+	f = f - SVM_FROMI(i);
+	if(f>SVM_C(1.0)) f = SVM_C(1.0);
+	return tbl[i] + SVM_MPY(f, tbl[i+1] - tbl[i]);
+}
+
 /** Space Vector Pulse Width Modulation.
  *
  * This function reads the normalized output voltages in alpha-beta
  * frame and calculates the on-times for the 3 PWM duty cycle registers
  * using one of several methods.
  *
- * Inputs:
- * + SvmAlpha   normalized reference voltage in alpha
- * + SvmBeta    normalized reference voltage in beta
- * + SvmPeriod  integer counts in a pwm period
- * + SvmMethod  integer 1=symmetric, 2=bus clamp 60 degree odd, 3=bus clamp 60 degree even.
+ * All state is in the argument structs and locals, so the function is
+ * reentrant and one call can serve each inverter on the board.
+ *
+ * Inputs (in):
+ * + Alpha   normalized reference voltage in alpha
+ * + Beta    normalized reference voltage in beta
+ * + Period  integer counts in a pwm period
+ * + Method  integer 1=symmetric, 2=bus clamp 60 degree odd, 3=bus clamp 60 degree even,
+ *           4=automatic, symmetric below ClampOff and bus clamp odd above ClampOn.
+ *           5=DPWMMIN, 6=DPWMMAX, 7=DPWM1, 8=DPWM3, 9=discontinuous with
+ *           the clamp boundary at Psi.
+ * + ClampOn, ClampOff  |Vref| thresholds of the automatic method
+ * + SinPsi, SinPsi3  sin(Psi) and sin(pi/3 - Psi) of the clamp boundary
+ *           Psi within the sector for method 9, set by SvmSetPsi
+ * + OverMod 0 clips Vref to the hexagon, 1 runs overmodulation modes I and
+ *           II up to six-step at |Vref| = SVM_SIX_STEP
+ * + DtcMode 0=no deadtime compensation, 1=from Ia, Ib, Ic, 2=from the
+ *           reference current IAlpha, IBeta
+ * + Dtc     deadtime compensation in counts
+ * + DtcBand current where the compensation reaches Dtc
+ * + MinMode 0=no pulse limit, 1=widen pulses shorter than MinPulse, 2=drop
+ *           or widen them, whichever is nearer
+ * + MinPulse  shortest pulse in counts, high or low
  *
- * Outputs:
- * + SvmOnA	  on time for pwm duty register A
- * + SvmOnB	  on time for pwm duty register B
- * + SvmOnC	  on time for pwm duty register C
- * + SvmClip	  flag to indicate clipping
- * + SvmK		  clipping coefficient on magnitude of Vref
+ * Outputs (out):
+ * + OnA	  on time for pwm duty register A
+ * + OnB	  on time for pwm duty register B
+ * + OnC	  on time for pwm duty register C
+ * + Tx, Ty, T0  normalized active and zero vector times
+ * + Sector  sector 1 to 6
+ * + Clip	  flag to indicate clipping
+ * + K		  clipping coefficient on magnitude of Vref
+ * + Active  method in use, also state for the automatic method
+ * + OverMode  0 linear or clipped, 1 or 2 overmodulation mode
+ * + CarryA, CarryB, CarryC  on time owed by the pulse limit, counts
  *
+ * All values are svm_t, float or Q15 as set by SVM_IQ.
+ *
+ * Sector, Active and the Carry values are read back on the next call, so
+ * keep out between calls.  All methods share one table of active vector
+ * times and differ only in how the zero time is split, so each has the
+ * same volt-seconds between phases.  An unknown method runs symmetric.
  */
-#pragma CODE_SECTION(UpdateSpaceVector, "ramfuncs");
-void UpdateSpaceVector(void){
+#pragma CODE_SECTION(SpaceVector, "ramfuncs");
+void SpaceVector(const SvmInputs *in, SvmOutputs *out){
+
+	svm_t alpha = in->Alpha;
+	svm_t beta = in->Beta;
+	svm_t period = SVM_FROMI(in->Period);
+	svm_t betaSqrt3, alphaAbs;
+	svm_t tx, ty, t0, k;
+	svm_t t[4];
+	svm_t k0, tz, mag2, g, hold;
+	svm_t ia, ib, ic;
+	int sector;
+	int method;
+	int late;
+	int drop;
 
 	// Compute some scaled values
-	SvmBetaSqrt3 = SvmBeta * RECIP_SQRT3;
-	SvmAlphaAbs = fabs(SvmAlpha);
-	SvmSector = 0;
+	betaSqrt3 = SVM_MPY(beta, SVM_C(RECIP_SQRT3));
+	alphaAbs = SVM_ABS(alpha);
+	sector = 0;
 
 	// Determine which sector based on alpha-beta
-	if(SvmBeta>=0){
+	if(beta>=0){
 		// Must be sector 1,2,3
-		if(SvmAlphaAbs < fabs(SvmBetaSqrt3)){
-			SvmSector = 2;
+		if(alphaAbs < SVM_ABS(betaSqrt3)){
+			sector = 2;
 		}else{
-			if(SvmAlpha>=0){
-				SvmSector = 1;
+			if(alpha>=0){
+				sector = 1;
 			}else{
-				SvmSector = 3;
+				sector = 3;
 			}
 		}
 	}else{
 		// Must be sector 4,5,6
-		if(SvmAlphaAbs < fabs(SvmBetaSqrt3)){
-			SvmSector = 5;
+		if(alphaAbs < SVM_ABS(betaSqrt3)){
+			sector = 5;
 		}else{
-			if(SvmAlpha>=0){
-				SvmSector = 6;
+			if(alpha>=0){
+				sector = 6;
 			}else{
-				SvmSector = 4;
+				sector = 4;
 			}
 		}
 
 	}
 
 	// Calculate on-times for active vectors X and Y
-	if((SvmSector==2)||(SvmSector==5)){
+	if((sector==2)||(sector==5)){
 		// group 1
-		SvmTx = SvmAlpha + fabs(SvmBetaSqrt3);
-		SvmTy = -SvmAlpha + fabs(SvmBetaSqrt3);
+		tx = alpha + SVM_ABS(betaSqrt3);
+		ty = -alpha + SVM_ABS(betaSqrt3);
 	}else{
-		SvmTx = fabs(SvmAlpha)-fabs(SvmBetaSqrt3);
-		SvmTy = 2.0*fabs(SvmBetaSqrt3);
+		tx = SVM_ABS(alpha)-SVM_ABS(betaSqrt3);
+		ty = 2*SVM_ABS(betaSqrt3);
+	}
+
+	// Overmodulation.  Mode I raises Vref by a gain from the table so that
+	// after the hexagon clip below the fundamental is still |Vref|.  Mode II
+	// starts from the point on the hexagon and holds it at a vertex for a
+	// share of the side, reaching six-step at SVM_OM_SIX2.
+	mag2 = SVM_MPY(alpha,alpha) + SVM_MPY(beta,beta);
+	hold = 0;
+	out->OverMode = 0;
+	if(in->OverMod && mag2>SVM_C(SVM_OM_LIN2)){
+		if(mag2<SVM_C(SVM_OM_HEX2)){
+			out->OverMode = 1;
+			g = SvmOmTable(SvmOmGain,mag2,SVM_C(SVM_OM_LIN2),
+				SVM_C((SVM_OM_POINTS-1)/(SVM_OM_HEX2-SVM_OM_LIN2)));
+			tx = SVM_MPY(g,tx);
+			ty = SVM_MPY(g,ty);
+		}else{
+			out->OverMode = 2;
+			hold = SvmOmTable(SvmOmHold,mag2,SVM_C(SVM_OM_HEX2),
+				SVM_C((SVM_OM_POINTS-1)/(SVM_OM_SIX2-SVM_OM_HEX2)));
+		}
 	}
 
 	// Calculate zero time, rescale Tx and Ty if in overmodulation
-	// Set or reset the flag SvmClip
-	SvmT0 = 1.0 - SvmTx - SvmTy;
-	if(SvmT0<0){
-		SvmT0 = 0;
-		SvmClip = 1;
-		SvmK = 1.0 / (SvmTx+SvmTy);
-		SvmTx = SvmK * SvmTx;
-		SvmTy = SvmK * SvmTy;
+	// Set or reset the flag Clip.  Mode II always takes the point on the
+	// hexagon, this one reciprocal does it.
+	t0 = SVM_C(1.0) - tx - ty;
+	if(t0<0 || out->OverMode==2){
+		t0 = 0;
+		out->Clip = 1;
+		k = SVM_RECIP(tx+ty);
+		tx = SVM_MPY(k,tx);
+		ty = SVM_MPY(k,ty);
 	}else{
-		SvmClip = 0;
-		SvmK = 1.0;
+		out->Clip = 0;
+		k = SVM_C(1.0);
 	}
-
-	// Assign on-times based on Tx, Ty, and T0 times combined with sector
-	if(SvmMethod == 1){
-		// Standard symmetric SVM
-		SvmT02 = SvmT0 * 0.5;
-		switch(SvmSector){
-		case 1:
-			SvmOnA = SvmPeriod*(SvmTx + SvmTy + SvmT02);
-			SvmOnB = SvmPeriod*(SvmTy + SvmT02);
-			SvmOnC = SvmPeriod*(SvmT02);
-			break;
-		case 2:
-			SvmOnA = SvmPeriod*(SvmTx + SvmT02);
-			SvmOnB = SvmPeriod*(SvmTx + SvmTy + SvmT02);
-			SvmOnC = SvmPeriod*(SvmT02);
-			break;
-		case 3:
-			SvmOnA = SvmPeriod*(SvmT02);
-			SvmOnB = SvmPeriod*(SvmTx + SvmTy + SvmT02);
-			SvmOnC = SvmPeriod*(SvmTx + SvmT02);
-			break;
-		case 4:
-			SvmOnA = SvmPeriod*(SvmT02);
-			SvmOnB = SvmPeriod*(SvmTx + SvmT02);
-			SvmOnC = SvmPeriod*(SvmTx + SvmTy + SvmT02);
-			break;
-		case 5:
-			SvmOnA = SvmPeriod*(SvmTx + SvmT02);
-			SvmOnB = SvmPeriod*(SvmT02);
-			SvmOnC = SvmPeriod*(SvmTx + SvmTy + SvmT02);
-			break;
-		case 6:
-			SvmOnA = SvmPeriod*(SvmTx + SvmTy + SvmT02);
-			SvmOnB = SvmPeriod*(SvmT02);
-			SvmOnC = SvmPeriod*(SvmTy + SvmT02);
-			break;
-		default:			// just for safety, should never execute
-			SvmOnA = 0;
-			SvmOnB = 0;
-			SvmOnC = 0;
-			break;
+	if(hold>0){
+		g = ty;
+		if(g<=hold){
+			g = 0;
+		}else if(g>=SVM_C(1.0)-hold){
+			g = SVM_C(1.0);
+		}else{
+			g = SVM_MPY(g - hold, SVM_RECIP(SVM_C(1.0) - 2*hold));
 		}
+		tx = SVM_C(1.0) - g;
+		ty = g;
 	}
 
-#if(0)	// May want to exclude from executable to gain codespace
-	if(SvmMethod == 2){
-		// Bus Clamped 60 degree odd SVM
-		switch(SvmSector){
-		case 1:
-			SvmOnA = SvmPeriod;
-			SvmOnB = SvmPeriod*(SvmTy + SvmT0);
-			SvmOnC = SvmPeriod*(SvmT0);
-			break;
-		case 2:
-			SvmOnA = SvmPeriod*(SvmTx);
-			SvmOnB = SvmPeriod*(SvmTx + SvmTy);
-			SvmOnC = 0;
-			break;
-		case 3:
-			SvmOnA = SvmPeriod*(SvmT0);
-			SvmOnB = SvmPeriod;
-			SvmOnC = SvmPeriod*(SvmTx + SvmT0);
-			break;
-		case 4:
-			SvmOnA = 0;
-			SvmOnB = SvmPeriod*(SvmTx);
-			SvmOnC = SvmPeriod*(SvmTx + SvmTy);
-			break;
-		case 5:
-			SvmOnA = SvmPeriod*(SvmTx + SvmT0);
-			SvmOnB = SvmPeriod*(SvmT0);
-			SvmOnC = SvmPeriod;
-			break;
-		case 6:
-			SvmOnA = SvmPeriod*(SvmTx + SvmTy);
-			SvmOnB = 0;
-			SvmOnC = SvmPeriod*(SvmTy);
-			break;
-		default:			// just for safety, should never execute
-			SvmOnA = 0;
-			SvmOnB = 0;
-			SvmOnC = 0;
-			break;
+	// Pick the method.  The automatic method moves between symmetric and
+	// bus clamped on the squared magnitude with hysteresis, and only at a
+	// sector boundary, where the clamped phase changes anyway.
+	method = in->Method;
+	if(method==SVM_AUTO){
+		method = out->Active;
+		if(sector!=out->Sector || (method!=SVM_SYMMETRIC && method!=SVM_CLAMP_ODD)){
+			if(mag2 > SVM_MPY(in->ClampOn,in->ClampOn)){
+				method = SVM_CLAMP_ODD;
+			}else if(mag2 < SVM_MPY(in->ClampOff,in->ClampOff) || method!=SVM_CLAMP_ODD){
+				method = SVM_SYMMETRIC;
+			}
 		}
 	}
-#endif
+	out->Active = method;
+
+	t[0] = 0;
+	t[1] = tx;
+	t[2] = ty;
+	t[3] = tx + ty;
+
+	// Share of the zero time given to the all-on vector.  The discontinuous
+	// methods clamp high (1) or low (0), the clamp follows the sector parity
+	// and flips where the angle within the sector passes the clamp boundary.
+	// That angle is compared through the active vector times, the time of
+	// the vector starting the sector goes as sin(60-angle), the other as
+	// sin(angle).
+	switch(method){
+	case SVM_CLAMP_ODD:			// Bus Clamped 60 degree odd SVM, DPWM2
+		k0 = (sector & 1) ? SVM_C(1.0) : 0;
+		break;
+	case SVM_CLAMP_EVEN:		// Bus Clamped 60 degree even SVM, DPWM0
+		k0 = (sector & 1) ? 0 : SVM_C(1.0);
+		break;
+	case SVM_DPWMMIN:			// Clamped to the negative bus
+		k0 = 0;
+		break;
+	case SVM_DPWMMAX:			// Clamped to the positive bus
+		k0 = SVM_C(1.0);
+		break;
+	case SVM_DPWM1:				// Clamp boundary at 30 degrees
+	case SVM_DPWM3:
+		late = t[3-SvmStart[sector]] >= t[SvmStart[sector]];
+		k0 = ((sector & 1) ^ late ^ (method==SVM_DPWM3)) ? SVM_C(1.0) : 0;
+		break;
+	case SVM_DPWM:				// Clamp boundary at Psi
+		late = SVM_MPY(t[3-SvmStart[sector]], in->SinPsi3)
+			>= SVM_MPY(t[SvmStart[sector]], in->SinPsi);
+		k0 = ((sector & 1) ^ late) ? SVM_C(1.0) : 0;
+		break;
+	default:					// Standard symmetric SVM
+		k0 = SVM_C(0.5);
+		break;
+	}
+
+	// Assign on-times based on Tx, Ty, and T0 times combined with sector,
+	// each phase is on for its active vector time plus k0 of the zero time
+	tz = SVM_MPY(k0,t0);
+	out->OnA = SVM_MPY(period, t[SvmActive[sector][0]] + tz);
+	out->OnB = SVM_MPY(period, t[SvmActive[sector][1]] + tz);
+	out->OnC = SVM_MPY(period, t[SvmActive[sector][2]] + tz);
 
-#if(0)	// May want to exclude from executable to gain codespace
-	if(SvmMethod == 3){
-		// Bus Clamped 60 degree even SVM
-		switch(SvmSector){
-		case 1:
-			SvmOnA = SvmPeriod*(SvmTx + SvmTy);
-			SvmOnB = SvmPeriod*(SvmTy);
-			SvmOnC = 0;
-			break;
-		case 2:
-			SvmOnA = SvmPeriod*(SvmTx + SvmT0);
-			SvmOnB = SvmPeriod;
-			SvmOnC = SvmPeriod*(SvmT0);
-			break;
-		case 3:
-			SvmOnA = 0;
-			SvmOnB = SvmPeriod*(SvmTx + SvmTy);
-			SvmOnC = SvmPeriod*(SvmTx);
-			break;
-		case 4:
-			SvmOnA = SvmPeriod*(SvmT0);
-			SvmOnB = SvmPeriod*(SvmTx + SvmT0);
-			SvmOnC = SvmPeriod;
-			break;
-		case 5:
-			SvmOnA = SvmPeriod*(SvmTx);
-			SvmOnB = 0;
-			SvmOnC = SvmPeriod*(SvmTx + SvmTy);
-			break;
-		case 6:
-			SvmOnA = SvmPeriod;
-			SvmOnB = SvmPeriod*(SvmT0);
-			SvmOnC = SvmPeriod*(SvmTy + SvmT0);
-			break;
-		default:			// just for safety, should never execute
-			SvmOnA = 0;
-			SvmOnB = 0;
-			SvmOnC = 0;
-			break;
+	// Deadtime compensation, each phase gains Dtc counts in the direction of
+	// its current.  Inside +/-DtcBand the correction ramps linearly, so a
+	// noisy zero crossing does not chatter between +Dtc and -Dtc.  The
+	// reference current option takes the phase currents from the reference
+	// vector, which is clean at low speed.
+	if(in->DtcMode!=SVM_DTC_OFF){
+		if(in->DtcMode==SVM_DTC_REF){
+			ia = in->IAlpha;
+			ib = SVM_MPY(in->IBeta, SVM_C(SVM_SQRT3_2)) - (in->IAlpha/2);
+			ic = -ia - ib;
+		}else{
+			ia = in->Ia;
+			ib = in->Ib;
+			ic = in->Ic;
 		}
+		g = (in->DtcBand>0) ? SVM_MPY(in->Dtc, SVM_RECIP(in->DtcBand)) : 0;
+		out->OnA = SvmDeadtime(out->OnA, ia, in->DtcBand, g, in->Dtc, period);
+		out->OnB = SvmDeadtime(out->OnB, ib, in->DtcBand, g, in->Dtc, period);
+		out->OnC = SvmDeadtime(out->OnC, ic, in->DtcBand, g, in->Dtc, period);
 	}
-#endif
 
-#if(0)
-	// deadtime compensation
-	if(Ia>0){
-		SvmOnA = SvmOnA + SvmDtc;
-		if(SvmOnA>SvmPeriod)SvmOnA=SvmPeriod;
+	// Minimum pulse width, last so that it sees the final on times
+	if(in->MinMode!=SVM_MIN_OFF){
+		drop = (in->MinMode==SVM_MIN_DROP);
+		out->OnA = SvmPulse(out->OnA, &out->CarryA, in->MinPulse, period, drop);
+		out->OnB = SvmPulse(out->OnB, &out->CarryB, in->MinPulse, period, drop);
+		out->OnC = SvmPulse(out->OnC, &out->CarryC, in->MinPulse, period, drop);
 	}else{
-		SvmOnA = SvmOnA - SvmDtc;
-		if(SvmOnA<0)SvmOnA=0;
+		out->CarryA = 0;
+		out->CarryB = 0;
+		out->CarryC = 0;
 	}
 
-	if(Ib>0){
-		SvmOnB = SvmOnB + SvmDtc;
-		if(SvmOnB>SvmPeriod)SvmOnB=SvmPeriod;
-	}else{
-		SvmOnB = SvmOnB - SvmDtc;
-		if(SvmOnB<0)SvmOnB=0;
+	out->Tx = tx;
+	out->Ty = ty;
+	out->T0 = t0;
+	out->K = k;
+	out->Sector = sector;
+}
+
+
+/** Space vector modulation on the global Svm variables.
+ *
+ * Inputs SvmAlpha, SvmBeta, SvmPeriod and SvmMethod, deadtime compensation
+ * from SvmDtcMode, SvmDtc, SvmDtcBand and Ia, Ib, Ic or SvmIAlpha,
+ * SvmIBeta; outputs SvmOnA,
+ * SvmOnB, SvmOnC, SvmClip and SvmK, with SvmSector, SvmTx, SvmTy and
+ * SvmT0 kept for watching, and the compare counts staged in SvmCmp for
+ * CommitPwm.  The scratch values SvmBetaSqrt3, SvmAlphaAbs
+ * and SvmT02 are no longer written.  The globals stay float, a fixed point
+ * build converts them here, so time critical callers there should fill
+ * SvmInputs directly.
+ */
+#pragma CODE_SECTION(UpdateSpaceVector, "ramfuncs");
+void UpdateSpaceVector(void){
+
+	SvmInputs in;
+	static SvmOutputs out;		// kept for the automatic method and pulse limit
+	static float psi = -1.0;	// SvmPsi of the sines in sines
+	static SvmInputs sines;
+
+	in.Alpha = SVM_FROMF(SvmAlpha);
+	in.Beta = SVM_FROMF(SvmBeta);
+	in.Period = SvmPeriod;
+	in.Method = SvmMethod;
+	in.ClampOn = SVM_FROMF(SvmClampOn);
+	in.ClampOff = SVM_FROMF(SvmClampOff);
+	if(SvmPsi != psi){
+		psi = SvmPsi;
+		SvmSetPsi(&sines, psi);
 	}
+	in.SinPsi = sines.SinPsi;
+	in.SinPsi3 = sines.SinPsi3;
+	in.OverMod = SvmOverMod;
+	in.DtcMode = SvmDtcMode;
+	in.Dtc = SVM_FROMF(SvmDtc);
+	in.DtcBand = SVM_FROMF(SvmDtcBand);
+	in.Ia = SVM_FROMF(Ia);
+	in.Ib = SVM_FROMF(Ib);
+	in.Ic = SVM_FROMF(Ic);
+	in.IAlpha = SVM_FROMF(SvmIAlpha);
+	in.IBeta = SVM_FROMF(SvmIBeta);
+	in.MinMode = SvmMinMode;
+	in.MinPulse = SVM_FROMF(SvmMinPulse);
+	SpaceVector(&in, &out);
+	SvmOnA = SVM_TOF(out.OnA);
+	SvmOnB = SVM_TOF(out.OnB);
+	SvmOnC = SVM_TOF(out.OnC);
+	SvmTx = SVM_TOF(out.Tx);
+	SvmTy = SVM_TOF(out.Ty);
+	SvmT0 = SVM_TOF(out.T0);
+	SvmK = SVM_TOF(out.K);
+	SvmSector = out.Sector;
+	SvmClip = out.Clip;
+	StagePwm(&out, SvmPeriod, &SvmCmp);
+}
 
-	if(Ic>0){
-		SvmOnC = SvmOnC + SvmDtc;
-		if(SvmOnC>SvmPeriod)SvmOnC=SvmPeriod;
-	}else{
-		SvmOnC = SvmOnC - SvmDtc;
-		if(SvmOnC<0)SvmOnC=0;
+/** Set the SVM_DPWM clamp boundary of a modulator, psi in radians from 0
+ *  to pi/3.  SpaceVector takes the two sines so the ISR pass does not
+ *  evaluate them, call this when the boundary changes. */
+void SvmSetPsi(SvmInputs *in, float psi){
+
+	in->SinPsi = SVM_FROMF(sin(psi));
+	in->SinPsi3 = SVM_FROMF(sin(SVM_PI3 - psi));
+}
+
+/** Space vector modulation of every SvmInst, one pass from the ISR.
+ *  The cost is one SpaceVector call per instance. */
+#pragma CODE_SECTION(UpdateSpaceVectors, "ramfuncs");
+void UpdateSpaceVectors(void){
+
+	int i;
+
+	for(i=0;i<SVM_INSTANCES;i++){
+		SpaceVector(&SvmInst[i].In, &SvmInst[i].Out);
+		StagePwm(&SvmInst[i].Out, SvmInst[i].In.Period, &SvmInst[i].Cmp);
 	}
+}
+
+/** Convert one on time to compare counts, saturated to 0..period and
+ *  rounded to nearest */
+#pragma CODE_SECTION(SvmCounts, "ramfuncs");
+static unsigned int SvmCounts(svm_t on, svm_t period){
+
+	on = (on>period) ? period : on;
+	on = (on<0) ? 0 : on;
+#if(SVM_IQ)
+	return (unsigned int)((on + SVM_C(0.5)) >> 15);
+#elif defined(__TMS320C28XX_FPU32__)
+	return __f32toui16r(on);
+#else
+	return (unsigned int)(on + 0.5f);
 #endif
 }
+
+/** Stage the on times of one modulator pass as integer compare values.
+ *  Call after SpaceVector, outside the time critical commit. */
+#pragma CODE_SECTION(StagePwm, "ramfuncs");
+void StagePwm(const SvmOutputs *out, int period, SvmCompare *cmp){
+
+	svm_t p = SVM_FROMI(period);
+
+	cmp->CmpA = SvmCounts(out->OnA, p);
+	cmp->CmpB = SvmCounts(out->OnB, p);
+	cmp->CmpC = SvmCounts(out->OnC, p);
+}
+
+/** Write staged compare values to the ePWM compare registers, for example
+ *  &EPwm1Regs.CMPA.half.CMPA.  With the compare shadow loading at counter
+ *  zero, call early in the period, the ISR at the period boundary, and all
+ *  three phases take the new set at the next boundary together.  Only
+ *  three stores run with the interrupts held. */
+#pragma CODE_SECTION(CommitPwm, "ramfuncs");
+void CommitPwm(const SvmCompare *cmp, volatile unsigned int *cmpa,
+	volatile unsigned int *cmpb, volatile unsigned int *cmpc){
+
+	unsigned int a = cmp->CmpA;
+	unsigned int b = cmp->CmpB;
+	unsigned int c = cmp->CmpC;
+	unsigned int s;
+
+	s = SVM_LOCK();
+	*cmpa = a;
+	*cmpb = b;
+	*cmpc = c;
+	SVM_UNLOCK(s);
+}
@@ -0,0 +1,171 @@
+/**
+ * @file SVM.h
+ * @brief Space vector modulation interface.
+ *
+ * SpaceVector(in, out) and the UpdateSpaceVector wrapper over the Svm*
+ * globals, see SVM.c.
+ */
+
+#ifndef SVM_H_
+#define SVM_H_
+
+// Number format.  SVM_IQ 1 builds the modulator in Q15 fixed point for C2000
+// parts without the FPU, the same source runs in float otherwise.  Q15
+// holds on-times in counts up to a period of 65535.
+#ifndef SVM_IQ
+#define SVM_IQ			0		/**< Svm, 1 for Q15 fixed point, 0 for float */
+#endif
+
+#if(SVM_IQ)
+#ifdef HOST_SIM
+typedef long svm_t;
+#define SVM_C(x)		((svm_t)((x)*32768.0 + ((x)<0 ? -0.5 : 0.5)))
+#define SVM_MPY(a,b)	((svm_t)(((long long)(a)*(b))>>15))
+#define SVM_DIV(a,b)	((svm_t)(((long long)(a)<<15)/(b)))
+#define SVM_ABS(a)		((a)<0 ? -(a) : (a))
+#define SVM_SIN(a)		SVM_C(sin(SVM_TOF(a)))
+#define SVM_TOF(a)		((float)(a)*(1.0/32768.0))
+#define SVM_FROMF(x)	SVM_C(x)
+#define SVM_TOI(a)		((int)((a)>>15))
+#define SVM_FROMI(i)	((svm_t)(i)<<15)
+#else
+#include "IQmathLib.h"
+typedef _iq15 svm_t;
+#define SVM_C(x)		_IQ15(x)
+#define SVM_MPY(a,b)	_IQ15mpy(a,b)
+#define SVM_DIV(a,b)	_IQ15div(a,b)
+#define SVM_ABS(a)		_IQabs(a)
+#define SVM_SIN(a)		_IQ15sin(a)
+#define SVM_TOF(a)		_IQ15toF(a)
+#define SVM_FROMF(x)	_FtoIQ15(x)
+#define SVM_TOI(a)		_IQ15int(a)
+#define SVM_FROMI(i)	((svm_t)(i)<<15)
+#endif
+#else
+typedef float svm_t;
+#define SVM_C(x)		(x)
+#define SVM_MPY(a,b)	((a)*(b))
+#define SVM_DIV(a,b)	((a)/(b))
+#define SVM_ABS(a)		fabs(a)
+#define SVM_SIN(a)		sin(a)
+#define SVM_TOF(a)		(a)
+#define SVM_FROMF(x)	(x)
+#define SVM_TOI(a)		((int)(a))
+#define SVM_FROMI(i)	((svm_t)(i))
+#endif
+
+// Modulation methods, SvmInputs.Method and SvmMethod
+#define SVM_SYMMETRIC	1		/**< Svm method, zero time split evenly */
+#define SVM_CLAMP_ODD	2		/**< Svm method, bus clamp 60 degree odd */
+#define SVM_CLAMP_EVEN	3		/**< Svm method, bus clamp 60 degree even */
+#define SVM_AUTO		4		/**< Svm method, symmetric at low and bus clamp odd at high |Vref| */
+#define SVM_DPWMMIN		5		/**< Svm method, always clamped to the negative bus */
+#define SVM_DPWMMAX		6		/**< Svm method, always clamped to the positive bus */
+#define SVM_DPWM1		7		/**< Svm method, clamp the phase nearest its peak, 30 degree boundary */
+#define SVM_DPWM3		8		/**< Svm method, complement of DPWM1 */
+#define SVM_DPWM		9		/**< Svm method, clamp boundary at Psi, 0 is DPWM0, pi/6 DPWM1, pi/3 DPWM2 */
+#define SVM_DPWM0		SVM_CLAMP_EVEN	/**< Svm method, DPWM0 is the 60 degree even clamp */
+#define SVM_DPWM2		SVM_CLAMP_ODD	/**< Svm method, DPWM2 is the 60 degree odd clamp */
+#define SVM_PI3			1.0471976	/**< Svm, pi/3, one sector in radians */
+
+// Overmodulation, Vref is normalized to an active vector of 1
+#define SVM_LINEAR		0.8660254	/**< Svm, |Vref| at the end of the linear range, sqrt(3)/2 */
+#define SVM_SIX_STEP	0.9549297	/**< Svm, |Vref| of six-step, 3/pi, modulation index is |Vref|*pi/3 */
+#define SVM_OM_LIN2		0.75		/**< Svm, |Vref|^2 where mode I starts */
+#define SVM_OM_HEX2		0.8254541	/**< Svm, |Vref|^2 where mode II starts, trajectory is the hexagon */
+#define SVM_OM_SIX2		0.9118907	/**< Svm, |Vref|^2 of six-step */
+#define SVM_OM_POINTS	17			/**< Svm, points in each overmodulation table */
+
+// Deadtime compensation, source of the phase current polarity
+#define SVM_DTC_OFF		0		/**< Svm deadtime, no compensation */
+#define SVM_DTC_MEAS	1		/**< Svm deadtime, measured phase currents */
+#define SVM_DTC_REF		2		/**< Svm deadtime, reference current vector */
+#define SVM_SQRT3_2		0.8660254	/**< Svm, sqrt(3)/2 */
+
+// Minimum pulse width, what to do with a pulse shorter than MinPulse
+#define SVM_MIN_OFF		0		/**< Svm min pulse, no limit */
+#define SVM_MIN_CLAMP	1		/**< Svm min pulse, widen it to MinPulse */
+#define SVM_MIN_DROP	2		/**< Svm min pulse, drop it or widen it, whichever is nearer */
+
+// Inputs of one modulator pass
+typedef struct {
+	svm_t Alpha;		/**< Svm, normalized reference voltage in alpha */
+	svm_t Beta;			/**< Svm, normalized reference voltage in beta */
+	int Period;			/**< Svm, integer counts in a pwm period */
+	int Method;			/**< Svm, SVM_SYMMETRIC, SVM_AUTO or a clamped SVM_* method */
+	svm_t ClampOn;		/**< Svm, |Vref| above which SVM_AUTO bus clamps */
+	svm_t ClampOff;		/**< Svm, |Vref| below which SVM_AUTO returns to symmetric */
+	svm_t SinPsi;		/**< Svm, sin(Psi) of the SVM_DPWM clamp boundary Psi, see SvmSetPsi */
+	svm_t SinPsi3;		/**< Svm, sin(pi/3 - Psi) of the SVM_DPWM clamp boundary */
+	int OverMod;		/**< Svm, 1 for overmodulation modes I and II, 0 to clip to the hexagon */
+	int DtcMode;		/**< Svm, deadtime compensation source, SVM_DTC_* */
+	svm_t Dtc;			/**< Svm, deadtime compensation in counts */
+	svm_t DtcBand;		/**< Svm, current where the compensation reaches Dtc, 0 for a sign test */
+	svm_t Ia;			/**< Svm, measured phase current A for SVM_DTC_MEAS */
+	svm_t Ib;			/**< Svm, measured phase current B for SVM_DTC_MEAS */
+	svm_t Ic;			/**< Svm, measured phase current C for SVM_DTC_MEAS */
+	svm_t IAlpha;		/**< Svm, reference current in alpha for SVM_DTC_REF */
+	svm_t IBeta;		/**< Svm, reference current in beta for SVM_DTC_REF */
+	int MinMode;		/**< Svm, narrow pulse handling, SVM_MIN_* */
+	svm_t MinPulse;		/**< Svm, shortest pulse in counts the gate driver takes */
+} SvmInputs;
+
+// Results of one modulator pass
+typedef struct {
+	svm_t OnA;			/**< Svm, on time for pwm duty register A */
+	svm_t OnB;			/**< Svm, on time for pwm duty register B */
+	svm_t OnC;			/**< Svm, on time for pwm duty register C */
+	svm_t Tx;			/**< Svm, normalized time of active vector X */
+	svm_t Ty;			/**< Svm, normalized time of active vector Y */
+	svm_t T0;			/**< Svm, normalized time of the zero vectors */
+	svm_t K;			/**< Svm, clipping coefficient on magnitude of Vref */
+	int Sector;			/**< Svm, sector 1 to 6 */
+	int Clip;			/**< Svm, flag to indicate clipping */
+	int Active;			/**< Svm, method in use, SVM_AUTO picks it */
+	int OverMode;		/**< Svm, 0 linear or clipped, 1 or 2 overmodulation mode */
+	svm_t CarryA;		/**< Svm, on time owed to phase A by the pulse limit, counts */
+	svm_t CarryB;		/**< Svm, on time owed to phase B by the pulse limit, counts */
+	svm_t CarryC;		/**< Svm, on time owed to phase C by the pulse limit, counts */
+} SvmOutputs;
+
+// Compare values staged for the ePWM modules, integer counts in 0 to Period
+typedef struct {
+	unsigned int CmpA;	/**< Svm, staged compare for phase A */
+	unsigned int CmpB;	/**< Svm, staged compare for phase B */
+	unsigned int CmpC;	/**< Svm, staged compare for phase C */
+} SvmCompare;
+
+// One modulator per inverter, inputs and results side by side so each
+// instance is one contiguous block
+#ifndef SVM_INSTANCES
+#define SVM_INSTANCES	1		/**< Svm, inverters driven from this DSP */
+#endif
+
+typedef struct {
+	SvmInputs In;		/**< Svm instance, set by the current controller */
+	SvmOutputs Out;		/**< Svm instance, read by the pwm update */
+	SvmCompare Cmp;		/**< Svm instance, compare values for CommitPwm */
+} SvmInstance;
+
+extern SvmInstance SvmInst[SVM_INSTANCES];
+extern SvmCompare SvmCmp;
+extern float SvmClampOn;
+extern float SvmClampOff;
+extern float SvmPsi;
+extern int SvmOverMod;
+extern int SvmDtcMode;
+extern float SvmDtcBand;
+extern float SvmIAlpha;
+extern float SvmIBeta;
+extern int SvmMinMode;
+extern float SvmMinPulse;
+
+void SpaceVector(const SvmInputs *in, SvmOutputs *out);
+void SvmSetPsi(SvmInputs *in, float psi);
+void UpdateSpaceVector(void);
+void UpdateSpaceVectors(void);
+void StagePwm(const SvmOutputs *out, int period, SvmCompare *cmp);
+void CommitPwm(const SvmCompare *cmp, volatile unsigned int *cmpa,
+	volatile unsigned int *cmpb, volatile unsigned int *cmpc);
+
+#endif /* SVM_H_ */
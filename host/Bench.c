@@ -0,0 +1,429 @@
+/**
+ * @file Bench.c
+ * @brief Host cycle benchmarks of the ISR paths.
+ *
+ * Each case is timed call by call with SimCycles and reported as the
+ * median, the 99.9th percentile and the largest sample, less the cost of
+ * reading the counter.  The 99.9th percentile is the worst case that
+ * repeats, the largest sample usually includes an interrupt of the host.
+ * These are host cycles, they rank the paths and catch regressions but do
+ * not replace a measurement on the DSP.
+ *
+ * The readout path is timed in a loopback over the Unix socket BENCH_LINK,
+ * the receiver of XferTool.c against the real LogXfer.c, with the target
+ * background loop run while the receiver waits.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "Setup.h"
+#include "SVM.h"
+#include "SvmBase.h"
+#include "SvmIq.h"
+#include "Sim.h"
+#include "XferTool.h"
+
+#define BENCH_SAMPLES	100000L		/**< Bench, samples per case */
+#define BENCH_READS		50			/**< Bench, LogBuf reads timed for the throughput */
+#define BENCH_CAN_FPS	7800.0		/**< Bench, frames per second of a 1 Mbit/s bus, 8 data bytes, standard id */
+
+#ifndef BENCH_LINK
+#define BENCH_LINK	"unix:bench.sock"	/**< Bench, link of the readout loopback */
+#endif
+
+// The event rows are labelled with the build, make bench also runs them
+// built without EVENT_CRC
+#if(EVENT_CRC)
+#define BENCH_CRC		", record CRC"
+#else
+#define BENCH_CRC		", no record CRC"
+#endif
+
+static unsigned long long BenchSample[BENCH_SAMPLES];
+static unsigned long long BenchOverhead = 0;	// cycles of an empty measurement
+static unsigned long BenchSeed = 1;
+static long BenchPolls = 0;		// target background passes while the receiver waited
+
+extern int LogTrigger;
+
+/** Uniform random in -0.5 to 0.5 */
+static double BenchRand(void){
+
+	BenchSeed = BenchSeed*1103515245UL + 12345UL;
+	return (double)((BenchSeed>>16) & 0x7FFF) / 32768.0 - 0.5;
+}
+
+static int BenchCompare(const void *a, const void *b){
+
+	unsigned long long x = *(const unsigned long long *)a;
+	unsigned long long y = *(const unsigned long long *)b;
+
+	return (x>y) - (x<y);
+}
+
+/** Sort n samples and print the statistics of a case */
+static unsigned long long BenchReport(const char *name, long n){
+
+	unsigned long long med;
+	unsigned long long p999;
+	unsigned long long max;
+	long i;
+
+	for(i=0;i<n;i++){
+		BenchSample[i] = (BenchSample[i]>BenchOverhead) ? BenchSample[i]-BenchOverhead : 0;
+	}
+	qsort(BenchSample, n, sizeof(BenchSample[0]), BenchCompare);
+	med = BenchSample[n/2];
+	p999 = BenchSample[n - 1 - n/1000];
+	max = BenchSample[n-1];
+	printf("%-44s %8llu %8llu %8llu\n", name, med, p999, max);
+	return med;
+}
+
+/** Cost of reading the counter twice */
+static void BenchCalibrate(void){
+
+	unsigned long long t;
+	long i;
+
+	for(i=0;i<BENCH_SAMPLES;i++){
+		t = SimCycles();
+		BenchSample[i] = SimCycles() - t;
+	}
+	qsort(BenchSample, BENCH_SAMPLES, sizeof(BenchSample[0]), BenchCompare);
+	BenchOverhead = BenchSample[BENCH_SAMPLES/2];
+}
+
+/** UpdateFaults with a limit on every one of the 17 fault codes */
+static void BenchFaults(void){
+
+	static float sig[F_STALL+1];
+	unsigned long long t;
+	long i;
+	int c;
+
+	// Integrating, every signal over its trip level, none confirmed yet
+	SimInit();
+	for(c=0;c<=F_STALL;c++){
+		sig[c] = 2.0;
+		AddFaultLimit(&sig[c], 1.0, 0.5, 30000, c);
+	}
+	for(i=0;i<BENCH_SAMPLES/10;i++){
+		t = SimCycles();
+		UpdateFaults();
+		BenchSample[i] = SimCycles() - t;
+	}
+	BenchReport("UpdateFaults, 17 limits integrating", BENCH_SAMPLES/10);
+
+	// Latched, every limit confirmed and held
+	for(c=0;c<=F_STALL;c++){
+		sig[c] = 2.0;
+	}
+	SimInit();
+	for(c=0;c<=F_STALL;c++){
+		AddFaultLimit(&sig[c], 1.0, 0.5, 1, c);
+	}
+	UpdateFaults();
+	CommitEvents();
+	for(i=0;i<BENCH_SAMPLES;i++){
+		t = SimCycles();
+		UpdateFaults();
+		BenchSample[i] = SimCycles() - t;
+	}
+	BenchReport("UpdateFaults, 17 limits latched", BENCH_SAMPLES);
+
+	// The pass where all 17 confirm together, Fault() runs for each
+	for(i=0;i<1000;i++){
+		SimInit();
+		for(c=0;c<=F_STALL;c++){
+			AddFaultLimit(&sig[c], 1.0, 0.5, 1, c);
+		}
+		t = SimCycles();
+		UpdateFaults();
+		BenchSample[i] = SimCycles() - t;
+	}
+	BenchReport("UpdateFaults, 17 limits confirming at once", 1000);
+	ResetFaults();
+	CommitEvents();
+}
+
+/** The ISR post and the background commit of an event against the
+ *  synchronous LogEvent, and the commit of a full staging queue */
+static void BenchEvents(void){
+
+	unsigned long long t;
+	long i;
+	int k;
+
+	SimInit();
+	for(i=0;i<BENCH_SAMPLES;i++){
+		t = SimCycles();
+		LogEvent(E_SETPOINT,(int)i,1.0);
+		BenchSample[i] = SimCycles() - t;
+	}
+	BenchReport("LogEvent" BENCH_CRC, BENCH_SAMPLES);
+
+	for(i=0;i<BENCH_SAMPLES;i++){
+		t = SimCycles();
+		PostEvent(E_SETPOINT,(int)i,1.0);
+		BenchSample[i] = SimCycles() - t;
+		CommitEvents();
+	}
+	BenchReport("PostEvent" BENCH_CRC, BENCH_SAMPLES);
+
+	for(i=0;i<BENCH_SAMPLES;i++){
+		PostEvent(E_SETPOINT,(int)i,1.0);
+		t = SimCycles();
+		CommitEvents();
+		BenchSample[i] = SimCycles() - t;
+	}
+	BenchReport("CommitEvents, 1 staged" BENCH_CRC, BENCH_SAMPLES);
+
+	for(i=0;i<BENCH_SAMPLES/10;i++){
+		for(k=0;k<EVENT_QSIZE-1;k++) PostEvent(E_SETPOINT,k,1.0);
+		t = SimCycles();
+		CommitEvents();
+		BenchSample[i] = SimCycles() - t;
+	}
+	BenchReport("CommitEvents, queue full" BENCH_CRC, BENCH_SAMPLES/10);
+}
+
+/** The previous UpdateSpaceVector, SpaceVector on its own and the
+ *  UpdateSpaceVector wrapper over the globals, the same random points in
+ *  the linear range */
+static void BenchSpaceVector(void){
+
+	SvmInputs in = {0};
+	SvmOutputs out = {0};
+	unsigned long long t;
+	double r, th;
+	long i;
+
+	BenchSeed = 1;
+	SvmMethod = SVM_SYMMETRIC;
+	for(i=0;i<BENCH_SAMPLES;i++){
+		r = 0.8*(BenchRand()+0.5);
+		th = 2.0*M_PI*BenchRand();
+		SvmAlpha = r*cos(th);
+		SvmBeta = r*sin(th);
+		t = SimCycles();
+		UpdateSpaceVectorBase();
+		BenchSample[i] = SimCycles() - t;
+	}
+	BenchReport("previous UpdateSpaceVector, symmetric, linear", BENCH_SAMPLES);
+
+	in.Period = SvmPeriod;
+	in.Method = SVM_SYMMETRIC;
+	BenchSeed = 1;
+	for(i=0;i<BENCH_SAMPLES;i++){
+		r = 0.8*(BenchRand()+0.5);
+		th = 2.0*M_PI*BenchRand();
+		in.Alpha = r*cos(th);
+		in.Beta = r*sin(th);
+		t = SimCycles();
+		SpaceVector(&in, &out);
+		BenchSample[i] = SimCycles() - t;
+	}
+	BenchReport("SpaceVector, symmetric, linear", BENCH_SAMPLES);
+
+	in.Method = SVM_AUTO;
+	in.ClampOn = SvmClampOn;
+	in.ClampOff = SvmClampOff;
+	BenchSeed = 1;
+	for(i=0;i<BENCH_SAMPLES;i++){
+		r = 0.8*(BenchRand()+0.5);
+		th = 2.0*M_PI*BenchRand();
+		in.Alpha = r*cos(th);
+		in.Beta = r*sin(th);
+		t = SimCycles();
+		SpaceVector(&in, &out);
+		BenchSample[i] = SimCycles() - t;
+	}
+	BenchReport("SpaceVector, auto, linear", BENCH_SAMPLES);
+
+	in.Method = SVM_DPWM;
+	SvmSetPsi(&in, SvmPsi);
+	BenchSeed = 1;
+	for(i=0;i<BENCH_SAMPLES;i++){
+		r = 0.8*(BenchRand()+0.5);
+		th = 2.0*M_PI*BenchRand();
+		in.Alpha = r*cos(th);
+		in.Beta = r*sin(th);
+		t = SimCycles();
+		SpaceVector(&in, &out);
+		BenchSample[i] = SimCycles() - t;
+	}
+	BenchReport("SpaceVector, DPWM at Psi, linear", BENCH_SAMPLES);
+
+	BenchSeed = 1;
+	for(i=0;i<BENCH_SAMPLES;i++){
+		r = 0.8*(BenchRand()+0.5);
+		th = 2.0*M_PI*BenchRand();
+		SvmAlpha = r*cos(th);
+		SvmBeta = r*sin(th);
+		t = SimCycles();
+		UpdateSpaceVector();
+		BenchSample[i] = SimCycles() - t;
+	}
+	BenchReport("UpdateSpaceVector wrapper, symmetric, linear", BENCH_SAMPLES);
+}
+
+/** SpaceVector by operating region, the division free paths should cost
+ *  the same in and out of the linear range */
+static void BenchRegions(void){
+
+	static const struct {
+		const char *Name;
+		double Min;
+		double Max;
+		int OverMod;
+	} regions[4] = {
+		{ "SpaceVector, linear, deadtime on", 0.1, 0.85, 0 },
+		{ "SpaceVector, clipped, deadtime on", 0.9, 1.2, 0 },
+		{ "SpaceVector, overmodulation I, deadtime on", 0.87, 0.90, 1 },
+		{ "SpaceVector, overmodulation II, deadtime on", 0.91, 0.95, 1 }
+	};
+	SvmInputs in = {0};
+	SvmOutputs out = {0};
+	SvmIqIn q = {0};
+	SvmIqOut qo;
+	unsigned long long t;
+	double r, th;
+	long i;
+	int k;
+
+	for(k=0;k<4;k++){
+		in.Period = SvmPeriod;
+		in.Method = SVM_SYMMETRIC;
+		in.OverMod = regions[k].OverMod;
+		in.DtcMode = SVM_DTC_REF;
+		in.Dtc = 40.0;
+		in.DtcBand = 0.1;
+		BenchSeed = 1;
+		for(i=0;i<BENCH_SAMPLES;i++){
+			r = regions[k].Min + (regions[k].Max-regions[k].Min)*(BenchRand()+0.5);
+			th = 2.0*M_PI*BenchRand();
+			in.Alpha = r*cos(th);
+			in.Beta = r*sin(th);
+			in.IAlpha = 0.2*cos(th+0.3);
+			in.IBeta = 0.2*sin(th+0.3);
+			t = SimCycles();
+			SpaceVector(&in, &out);
+			BenchSample[i] = SimCycles() - t;
+		}
+		BenchReport(regions[k].Name, BENCH_SAMPLES);
+	}
+
+	// The Q15 build on this host, for the relative cost of its paths
+	q.Period = SvmPeriod;
+	q.Method = SVM_SYMMETRIC;
+	q.OverMod = 1;
+	SvmIqReset(0);
+	BenchSeed = 1;
+	for(i=0;i<BENCH_SAMPLES;i++){
+		r = 1.0*(BenchRand()+0.5);
+		th = 2.0*M_PI*BenchRand();
+		q.Alpha = r*cos(th);
+		q.Beta = r*sin(th);
+		t = SimCycles();
+		SvmIqRun(0, &q, &qo);
+		BenchSample[i] = SimCycles() - t;
+	}
+	BenchReport("Q15 SpaceVector with conversions, 0-1.0", BENCH_SAMPLES);
+}
+
+/** A whole simulated ISR pass, the rate the harness runs at */
+static void BenchIsr(void){
+
+	struct timespec a, b;
+	unsigned long long t;
+	long i;
+
+	SimInit();
+	LogTrigger = 1;
+	for(i=0;i<BENCH_SAMPLES;i++){
+		t = SimCycles();
+		SimIsr();
+		BenchSample[i] = SimCycles() - t;
+		if((SimTick % SIM_BG_EVERY)==0) SimBackground();
+	}
+	BenchReport("SimIsr, whole ISR pass with synthetic signals", BENCH_SAMPLES);
+
+	clock_gettime(CLOCK_MONOTONIC, &a);
+	SimRun(1000000L);
+	clock_gettime(CLOCK_MONOTONIC, &b);
+	printf("SimRun, %.2f million ISR passes per second\n",
+		1.0 / ((b.tv_sec-a.tv_sec) + 1e-9*(b.tv_nsec-a.tv_nsec)));
+}
+
+/** Target side of the loopback, one background pass of the link */
+static void BenchPoll(void){
+
+	XferHostPoll();
+	BenchPolls++;
+}
+
+/** Readout path, round trip of XFER_GET and the rate of a whole LogBuf */
+static void BenchXfer(void){
+
+	static unsigned short w[2*LOG_SIZE];
+	struct timespec a, b;
+	unsigned long frames;
+	unsigned long long t;
+	double s;
+	long value;
+	long i;
+
+	SimInit();
+	if(XferHostOpen(BENCH_LINK)!=0 || XferToolOpen(BENCH_LINK)!=0){
+		printf("xfer loopback, cannot open %s, skipped\n", BENCH_LINK);
+		return;
+	}
+	XferToolIdle = BenchPoll;
+
+	for(i=0;i<BENCH_SAMPLES/10;i++){
+		t = SimCycles();
+		XferToolGet(XFER_V_SKIP,&value);
+		BenchSample[i] = SimCycles() - t;
+	}
+	BenchReport("xfer XFER_GET round trip, loopback", BENCH_SAMPLES/10);
+
+	for(i=0;i<1000;i++){
+		t = SimCycles();
+		XferToolRead(XFER_R_INDEX,0L,XFER_INDEX_WORDS,w);
+		BenchSample[i] = SimCycles() - t;
+	}
+	BenchReport("xfer index read, loopback", 1000);
+
+	frames = XferToolFrames;
+	BenchPolls = 0;
+	clock_gettime(CLOCK_MONOTONIC, &a);
+	for(i=0;i<BENCH_READS;i++){
+		XferToolRead(XFER_R_LOGBUF,0L,2L*LOG_SIZE,w);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &b);
+	s = (b.tv_sec-a.tv_sec) + 1e-9*(b.tv_nsec-a.tv_nsec);
+	frames = XferToolFrames - frames;
+	printf("xfer LogBuf read, %.0f frames/s, %.1f times a 1 Mbit/s bus, %.1f frames per background pass\n",
+		frames/s, frames/s/BENCH_CAN_FPS, (double)frames/BenchPolls);
+
+	XferToolIdle = 0;
+	XferToolClose();
+	XferHostClose();
+}
+
+int main(void){
+
+	BenchCalibrate();
+	printf("%-44s %8s %8s %8s\n", "host cycles per call", "median", "p99.9", "max");
+	BenchEvents();
+	if(EVENT_CRC){
+		BenchFaults();
+		BenchSpaceVector();
+		BenchRegions();
+		BenchIsr();
+		BenchXfer();
+	}
+	return 0;
+}
@@ -0,0 +1,70 @@
+/**
+ * @file Check.c
+ * @brief Runs the host checks, exit status 1 when any fails.
+ *
+ * Usage: check [group ...], the groups are log, faults, xfer and svm.
+ */
+
+#include <string.h>
+#include "Setup.h"
+#include "Check.h"
+
+int CheckCount = 0;		/**< Checks run */
+int CheckFailed = 0;	/**< Checks failed */
+
+/** Count a check, print it when it fails */
+void CheckReport(int ok, const char *file, int line, const char *what){
+
+	CheckCount++;
+	if(!ok){
+		CheckFailed++;
+		printf("%s:%d: FAILED %s\n", file, line, what);
+	}
+}
+
+/** Slot of the oldest event with code written since EventTotal was from,
+ *  -1 when there is none */
+int CheckFindEvent(int code, unsigned long from){
+
+	unsigned long n;
+	int i;
+
+	n = EventTotal - from;
+	if(n>EVENT_SIZE) n = EVENT_SIZE;
+	i = EventIndex - (int)n;
+	if(i<0) i += EVENT_SIZE;
+	for(;n>0;n--){
+		if(EventCode[i]==code) return i;
+		i = (i+1) % EVENT_SIZE;
+	}
+	return -1;
+}
+
+static const struct {
+	const char *Name;
+	void (*Run)(void);
+} CheckGroups[] = {
+	{ "log", CheckLog },
+	{ "faults", CheckFaults },
+	{ "xfer", CheckXfer },
+	{ "svm", CheckSvm }
+};
+
+#define CHECK_GROUPS	((int)(sizeof(CheckGroups)/sizeof(CheckGroups[0])))
+
+int main(int argc, char **argv){
+
+	int i;
+	int k;
+
+	for(i=0;i<CHECK_GROUPS;i++){
+		if(argc>1){
+			for(k=1;k<argc && strcmp(argv[k],CheckGroups[i].Name)!=0;k++);
+			if(k==argc) continue;
+		}
+		printf("== %s\n", CheckGroups[i].Name);
+		CheckGroups[i].Run();
+	}
+	printf("%d checks, %d failed\n", CheckCount, CheckFailed);
+	return CheckFailed!=0;
+}
@@ -0,0 +1,78 @@
+/**
+ * @file Check.h
+ * @brief Host checks of the logging, fault and modulator code.
+ */
+
+#ifndef CHECK_H_
+#define CHECK_H_
+
+#include <stdio.h>
+
+/** Count a check, print it when it fails */
+#define CHECK(cond)		CheckReport((cond)!=0, __FILE__, __LINE__, #cond)
+
+extern int CheckCount;
+extern int CheckFailed;
+
+void CheckReport(int ok, const char *file, int line, const char *what);
+
+// Check groups, each returns after running all its checks
+void CheckLog(void);
+void CheckFaults(void);
+void CheckXfer(void);
+void CheckSvm(void);
+
+// Logs.c state read by the checks
+extern volatile unsigned long long LogTicks;
+extern float LogBuf[];
+extern int LogChan;
+extern int LogLength;
+extern int LogCount;
+extern int LogSingle;
+extern int LogSkip;
+extern int LogTrigger;
+extern int LogInit;
+extern int LogAuto;
+extern int LogHold;
+extern LogAddr_t LogAddr0, LogAddr1, LogAddr2;
+extern unsigned long long LogHdrStart;
+extern unsigned long LogHdrSamples;
+extern int LogHdrPeriod;
+extern int LogHdrTrigger;
+extern unsigned long long LogHdrTrigTick;
+extern LogAddr_t LogHdrAddr[];
+extern int LogHdrType[];
+extern int LogQ15;
+extern int LogMarkIndex;
+extern unsigned long LogMarkSample[];
+extern unsigned long long LogMarkTick[];
+extern int LogMarkPeriod[];
+extern long EventTime1[];
+extern long EventTime2[];
+extern int EventCode[];
+extern int EventData1[];
+extern float EventData2[];
+extern unsigned long long EventTicks[];
+extern int EventIndex;
+extern unsigned long EventTotal;
+extern int EventWarm;
+extern int EventBad;
+extern int EventBadFirst;
+extern unsigned int WarmEventCrc;
+extern int JournalSector;
+extern int JournalSlot;
+extern int EventQLost;
+extern long EventSyncPeriod;
+extern unsigned int EventVar[];
+extern int EventVarHead;
+extern int EventVarTail;
+extern const char * const EventSchema[];
+extern long FaultWord;
+extern unsigned long long FaultTick[];
+extern int FaultsActive;
+extern int FaultClass[];
+extern int FaultDebounce[];
+
+int CheckFindEvent(int code, unsigned long from);
+
+#endif /* CHECK_H_ */
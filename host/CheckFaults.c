@@ -0,0 +1,295 @@
+/**
+ * @file CheckFaults.c
+ * @brief Host checks of the fault registry, the reaction classes and the
+ * fault limits.
+ *
+ * Codes are raised from the ISR with SimInject.  The host build sets
+ * FAULT_COUNT past 32 so the bitset spans two words, F_STALL must reach
+ * FaultWord now that the test is a long, and a code out of range must be
+ * recorded as F_STATE.  A code of each reaction class must not react before
+ * its FaultDebounce count of consecutive passes, nor on as many scattered
+ * ones or calls in one pass, and then react as its class, logging one
+ * E_FAULT and one E_REACT.
+ * A signal held over the trip level of a limit must not confirm before the
+ * limit count and then react as its class on the confirming pass, a spike
+ * shorter than the limit must not trip at all, and inside the hysteresis
+ * band the count must hold.
+ * XFER_RESET from the CAN receive handler clears the faults only once
+ * UpdateXfer runs.
+ */
+
+#include "Setup.h"
+#include "Sim.h"
+#include "Check.h"
+
+#define CHECK_LIMIT		20		/**< Checks, ISR passes over trip to confirm */
+#define CHECK_HOLD		200		/**< Checks, ISR passes the signal is held */
+
+/** Events with code written since EventTotal was from */
+static int CheckCountEvents(int code, unsigned long from){
+
+	unsigned long n;
+	int i;
+	int count = 0;
+
+	n = EventTotal - from;
+	if(n>EVENT_SIZE) n = EVENT_SIZE;
+	i = EventIndex - (int)n;
+	if(i<0) i += EVENT_SIZE;
+	for(;n>0;n--){
+		if(EventCode[i]==code) count++;
+		i = (i+1) % EVENT_SIZE;
+	}
+	return count;
+}
+
+/** Set, test, walk and reset the active faults across both bitset words */
+static void CheckRegistry(void){
+
+	unsigned long long at;
+	unsigned long from;
+	int i;
+
+	SimInit();
+	CHECK(FaultsActive==0 && FaultNext(-1)==-1);
+	from = EventTotal;
+	at = SimTick + 10;
+	SimInject(at, 5, F_STALL, 16.0);
+	SimInject(at+20, 1, FAULT_COUNT-2, 1.0);
+	SimInject(at+30, 1, FAULT_COUNT+5, 2.0);
+	SimRun(50);
+	SimBackground();
+
+	// F_STALL is bit 16, past a 16-bit int
+	CHECK(FaultActive(F_STALL));
+	CHECK(FaultWord & (1L<<F_STALL));
+	CHECK(FaultActive(FAULT_COUNT-2));
+	CHECK(FaultActive(F_STATE));
+	CHECK(!FaultActive(FAULT_COUNT+5) && !FaultActive(-1));
+	CHECK(FaultsActive==3);
+
+	// Walked in order, the clear words are skipped
+	CHECK(FaultNext(-1)==F_STATE);
+	CHECK(FaultNext(F_STATE)==F_STALL);
+	CHECK(FaultNext(F_STALL)==FAULT_COUNT-2);
+	CHECK(FaultNext(FAULT_COUNT-2)==-1);
+
+	// Every occurrence is counted, the first is logged and timed
+	CHECK(LogStats.FaultCount[F_STALL]==5);
+	CHECK(CheckCountEvents(E_FAULT,from)==3);
+	i = CheckFindEvent(E_FAULT,from);
+	CHECK(i>=0 && EventData1[i]==F_STALL && EventData2[i]==16.0);
+	CHECK((FaultTick[F_STALL]>>LOG_SUBTICK_BITS)==at-1);
+
+	// Reset clears the active set and keeps the counts
+	ResetFaults();
+	CHECK(FaultsActive==0 && FaultNext(-1)==-1);
+	CHECK(!FaultActive(F_STALL) && FaultWord==0L);
+	CHECK(LogStats.FaultCount[F_STALL]==5 && FaultTick[F_STALL]==0);
+	from = EventTotal;
+	SimInject(SimTick+1, 1, F_STALL, 3.0);
+	SimRun(10);
+	SimBackground();
+	CHECK(FaultActive(F_STALL) && LogStats.FaultCount[F_STALL]==6);
+	CHECK(CheckCountEvents(E_FAULT,from)==1);
+}
+
+/** Raise code from a fresh board and check it reacts as class cls only
+ *  once asserted in FaultDebounce consecutive passes */
+static void CheckReact(int code, int cls){
+
+	unsigned long from;
+	float we;
+	int n;
+	int i;
+
+	SimInit();
+	CHECK(FaultClass[code]==cls);
+	n = FaultDebounce[cls];
+	from = EventTotal;
+	we = WeRef;
+
+	// Short of the debounce count nothing happens, nor do as many
+	// assertions with a pass between them or in the same pass
+	if(n>1){
+		SimInject(SimTick+1, n-1, code, 1.0);
+		SimRun(n+1);
+		CHECK(!FaultActive(code));
+		CHECK(mainState==READY && SimPwmOn && WeRef==we);
+		for(i=0;i<n;i++) SimInject(SimTick+1+2*i, 1, code, 1.0);
+		SimRun(2*n+1);
+		CHECK(!FaultActive(code));
+		CHECK(mainState==READY && SimPwmOn && WeRef==we);
+		for(i=0;i<n;i++) Fault(code, 1.0);
+		CHECK(!FaultActive(code));
+		SimRun(2);
+	}
+
+	// The count in consecutive passes and the class reacts
+	SimInject(SimTick+1, n, code, 2.0);
+	SimRun(n+1);
+	CHECK(FaultActive(code));
+	switch(cls){
+	case FC_DISABLE:
+		CHECK(mainState==FAULT && SimPwmOn==0 && WeRef==0);
+		break;
+	case FC_RAMP:
+		CHECK(mainState==READY && SimPwmOn);
+		CHECK(FaultRamp==1 && WeRef==0);
+		break;
+	case FC_DERATE:
+		CHECK(mainState==READY && SimPwmOn && WeRef==we);
+		CHECK(FaultDerate==FaultDerateLevel);
+		break;
+	default:
+		CHECK(mainState==READY && SimPwmOn && WeRef==we);
+		CHECK(FaultDerate==1.0 && FaultRamp==0);
+		break;
+	}
+
+	// Raised again, the reaction is logged once
+	SimInject(SimTick+1, 10, code, 3.0);
+	SimRun(20);
+	SimBackground();
+	CHECK(CheckCountEvents(E_FAULT,from)==1);
+	CHECK(CheckCountEvents(E_REACT,from)==1);
+	n = CheckFindEvent(E_REACT,from);
+	CHECK(n>=0 && EventData1[n]==cls && EventData2[n]==(float)code);
+
+	// Reset lifts the derate and the ramp
+	ResetFaults();
+	CHECK(!FaultActive(code) && FaultDerate==1.0 && FaultRamp==0);
+}
+
+/** Hold *signal at value past trip from a fresh board and check the
+ *  fault confirms after CHECK_LIMIT passes and reacts as class cls at once */
+static void CheckHold(int code, int cls, float *signal, float trip, float clear, float value){
+
+	unsigned long from;
+	unsigned long long at;
+	unsigned long count;
+	float we;
+	int i;
+
+	SimInit();
+	CHECK(FaultClass[code]==cls);
+	AddFaultLimit(signal, trip, clear, CHECK_LIMIT, code);
+	SimBackground();
+	from = EventTotal;
+	count = LogStats.FaultCount[code];
+	we = WeRef;
+	at = SimTick + 10;
+
+	// A spike shorter than the limit is ignored
+	SimOverride(at, CHECK_LIMIT/2, signal, value);
+	SimRun(10 + CHECK_LIMIT);
+	CHECK(!FaultActive(code));
+
+	// Held over trip, nothing until the limit count, then the reaction
+	at = SimTick + 10;
+	SimOverride(at, CHECK_HOLD, signal, value);
+	SimRun(9 + CHECK_LIMIT - 1);
+	CHECK(!FaultActive(code));
+	CHECK(mainState==READY && SimPwmOn && WeRef==we && FaultDerate==1.0);
+	SimRun(1);
+	CHECK(FaultActive(code));
+	switch(cls){
+	case FC_DISABLE:
+		CHECK(mainState==FAULT && SimPwmOn==0);
+		break;
+	case FC_RAMP:
+		CHECK(mainState==READY && SimPwmOn);
+		CHECK(FaultRamp==1 && WeRef==0);
+		break;
+	case FC_DERATE:
+		CHECK(mainState==READY && SimPwmOn && WeRef==we);
+		CHECK(FaultDerate==FaultDerateLevel);
+		break;
+	default:
+		CHECK(mainState==READY && SimPwmOn && WeRef==we);
+		CHECK(FaultDerate==1.0 && FaultRamp==0);
+		break;
+	}
+
+	// Latched while held, the fault and the reaction are logged once
+	SimRun(CHECK_HOLD);
+	SimBackground();
+	CHECK(LogStats.FaultCount[code]==count+1);
+	CHECK(CheckCountEvents(E_FAULT,from)==1);
+	CHECK(CheckCountEvents(E_REACT,from)==1);
+	i = CheckFindEvent(E_FAULT,from);
+	CHECK(i>=0 && EventData1[i]==code && EventData2[i]==value);
+	i = CheckFindEvent(E_REACT,from);
+	CHECK(i>=0 && EventData1[i]==cls && EventData2[i]==(float)code);
+}
+
+/** Inside the hysteresis band the count holds, beyond clear it dumps,
+ *  and ResetFaults lets a condition still present assert again */
+static void CheckHysteresis(void){
+
+	unsigned long long at;
+
+	SimInit();
+	AddFaultLimit(&SimBus, 400.0, 380.0, CHECK_LIMIT, F_OVERVOLT);
+
+	// Over, beyond clear, over again, never CHECK_LIMIT in a row
+	at = SimTick + 10;
+	SimOverride(at, CHECK_LIMIT-2, &SimBus, 450.0);
+	SimOverride(at+CHECK_LIMIT-2, 5, &SimBus, 300.0);
+	SimOverride(at+CHECK_LIMIT+3, CHECK_LIMIT-2, &SimBus, 450.0);
+	SimRun(10 + 3*CHECK_LIMIT);
+	CHECK(!FaultActive(F_OVERVOLT));
+
+	// Over, in the band, over again, the count carries through the band
+	at = SimTick + 10;
+	SimOverride(at, CHECK_LIMIT-2, &SimBus, 450.0);
+	SimOverride(at+CHECK_LIMIT-2, 50, &SimBus, 390.0);
+	SimOverride(at+CHECK_LIMIT+48, 2, &SimBus, 450.0);
+	SimRun(9 + CHECK_LIMIT+49);
+	CHECK(!FaultActive(F_OVERVOLT));
+	SimRun(1);
+	CHECK(FaultActive(F_OVERVOLT));
+
+	// Still over after a reset, it confirms again
+	ResetFaults();
+	SimOverride(SimTick+1, CHECK_HOLD, &SimBus, 450.0);
+	SimRun(CHECK_LIMIT);
+	CHECK(FaultActive(F_OVERVOLT));
+}
+
+/** XFER_RESET is left to the background loop */
+static void CheckXferReset(void){
+
+	unsigned short w[4] = { XFER_RESET<<8, 0, 0, 0 };
+	unsigned long from;
+
+	SimInit();
+	SimInject(SimTick+1, 1, F_OVERCURRENT, 1.0);
+	SimRun(SIM_BG_EVERY);
+	CHECK(FaultActive(F_OVERCURRENT) && mainState==FAULT);
+	from = EventTotal;
+	XferReceive(w);
+	CHECK(FaultActive(F_OVERCURRENT) && mainState==FAULT);
+	CHECK(EventTotal==from);
+	UpdateXfer();
+	CHECK(!FaultActive(F_OVERCURRENT) && mainState==READY);
+	CHECK(CheckFindEvent(E_RESET,from)>=0);
+	UpdateXfer();
+	CHECK(CheckCountEvents(E_RESET,from)==1);
+}
+
+/** Fault registry, reaction and limit checks */
+void CheckFaults(void){
+
+	CheckRegistry();
+	CheckReact(F_OVERCURRENT, FC_DISABLE);
+	CheckReact(F_CANBUS, FC_RAMP);
+	CheckReact(F_OVERTEMP, FC_DERATE);
+	CheckReact(F_SPEED, FC_WARN);
+	CheckHold(F_OVERVOLT, FC_DISABLE, &SimBus, 400.0, 380.0, 450.0);
+	CheckHold(F_UNDERVOLT, FC_RAMP, &SimBus, 200.0, 220.0, 150.0);
+	CheckHold(F_OVERTEMP, FC_DERATE, &SimTemp, 90.0, 80.0, 100.0);
+	CheckHold(F_SPEED, FC_WARN, &SimSpeedErr, 3000.0, 2000.0, 4000.0);
+	CheckHysteresis();
+	CheckXferReset();
+}
@@ -0,0 +1,777 @@
+/**
+ * @file CheckLog.c
+ * @brief Host checks of the datalog and the event log.
+ *
+ * Trigger and wraparound of LogBuf, the decoding of a capture by its
+ * header and markers over a change of LogSkip, wraparound of the event
+ * ring and of the TimeStamp parts and of the low 32 bits of the tick, the
+ * order and dating of posted events, the E_SYNC records, the instance tag
+ * of a code, the freeze of a capture by a fault, and the channel types of
+ * DefaultLog(2) in the float and the SVM_IQ build.
+ */
+
+#include <string.h>
+#include <math.h>
+#include "Setup.h"
+#include "SVM.h"
+#include "Sim.h"
+#include "Check.h"
+
+static float CheckSnap[LOG_SIZE];	// LogBuf when the capture froze
+
+/** Newest sample of channel 0 */
+static float CheckNewest(void){
+
+	return LogBuf[(LogCount==0) ? LogLength-1 : LogCount-1];
+}
+
+/** Triggering and wraparound of a one channel capture of SimRamp */
+static void CheckLogWrap(void){
+
+	unsigned long from;
+	int i;
+	int steps;
+	int k;
+
+	SimInit();
+	LogAddr0 = (LogAddr_t)&SimRamp;
+	LogChan = 1;
+	LogSkip = 0;
+	LogSingle = 0;
+	LogAuto = 0;
+	LogInit = 1;
+	SimRun(10);
+	CHECK(LogLength==LOG_SIZE);
+	CHECK(LogHdrSamples==0L);
+
+	// Record past the end, the buffer wraps and keeps the newest LOG_SIZE
+	from = EventTotal;
+	LogTrigger = 1;
+	SimRun(LOG_SIZE+123);
+	SimBackground();
+	CHECK(LogCount==123);
+	CHECK(LogHdrSamples==LOG_SIZE+123L);
+	CHECK(CheckNewest()==SimRamp);
+	steps = 0;
+	for(i=1,k=LogCount;i<LOG_SIZE;i++,k=(k+1)%LOG_SIZE){
+		if(LogBuf[(k+1)%LOG_SIZE]-LogBuf[k]==1.0) steps++;
+	}
+	CHECK(steps==LOG_SIZE-1);
+	i = CheckFindEvent(E_DATALOG,from);
+	CHECK(i>=0 && EventData1[i]==1);
+
+	// Single shot stops at the end of the buffer
+	LogSingle = 1;
+	LogInit = 1;
+	SimRun(1);
+	LogTrigger = 1;
+	SimRun(LOG_SIZE+50);
+	CHECK(LogTrigger==0);
+	CHECK(LogCount==0);
+	CHECK(LogHdrSamples==LOG_SIZE);
+	CHECK(LogBuf[LOG_SIZE-1]-LogBuf[0]==LOG_SIZE-1);
+
+	// A negative trigger records that many samples
+	LogSingle = 0;
+	LogInit = 1;
+	SimRun(1);
+	LogTrigger = -100;
+	SimRun(500);
+	CHECK(LogTrigger==0);
+	CHECK(LogCount==100);
+	CHECK(LogHdrSamples==100L);
+}
+
+/** A capture of SimRamp with LogSkip changed part way decodes from its
+ *  header and markers alone, sample k was taken at tick SimRamp */
+static void CheckHeader(void){
+
+	unsigned long long trig;
+	unsigned long long t;
+	int m;
+	int p;
+	int k;
+	int ok;
+
+	SimInit();
+	LogAddr0 = (LogAddr_t)&SimRamp;
+	LogChan = 1;
+	LogSkip = 0;
+	LogSingle = 1;
+	LogAuto = 0;
+	LogInit = 1;
+	SimRun(10);
+	CHECK(LogHdrAddr[0]==(LogAddr_t)&SimRamp && LogHdrAddr[1]==0);
+	CHECK(LogHdrType[0]==LOG_FLOAT);
+
+	LogTrigger = 1;
+	trig = LogTickNow() + (1<<LOG_SUBTICK_BITS);
+	SimRun(300);
+	CHECK(LogHdrTrigTick==trig && LogHdrTrigger==0);
+	LogSkip = 2;
+	SimRun(3*300);
+	LogTrigger = 0;
+	SimRun(3);
+	CHECK(LogHdrSamples==600L && LogHdrPeriod==3);
+	CHECK(LogMarkIndex==2);
+	CHECK(LogMarkSample[0]==0L && LogMarkTick[0]==LogHdrStart);
+	CHECK(LogMarkSample[1]==300L && LogMarkPeriod[1]==1);
+
+	// Decode, each sample is a period on from the newest marker before it,
+	// the period up to the next marker or LogHdrPeriod after the last
+	ok = 1;
+	for(k=0;k<600;k++){
+		m = (k<(int)LogMarkSample[1]) ? 0 : 1;
+		p = (m==0) ? LogMarkPeriod[1] : LogHdrPeriod;
+		t = (LogMarkTick[m]>>LOG_SUBTICK_BITS) + (unsigned long long)(k-LogMarkSample[m])*p;
+		if(LogBuf[k]!=(float)t) ok = 0;
+	}
+	CHECK(ok);
+}
+
+/** Time of an event in ISR passes */
+static long CheckTime(int i){
+
+	return EventTime1[i]*TIME2_WRAP + EventTime2[i]/TIME2_PER_TICK;
+}
+
+/** Wraparound of the event ring, of TimeStamp part 2 and of the low
+ *  32 bits of the tick, posted events keep their order and are dated back
+ *  to the pass that posted them */
+static void CheckEventWrap(void){
+
+	unsigned long long tick;
+	int first;
+	int lost;
+	int i;
+	int n;
+	int ok;
+
+	SimInit();
+	first = EventIndex;
+	for(n=0;n<3*EVENT_SIZE+5;n++){
+		SimRun(3);
+		LogEvent(E_SETPOINT,n,(float)n);
+	}
+	CHECK(EventIndex==(first+3*EVENT_SIZE+5)%EVENT_SIZE);
+
+	// Oldest to newest the times never step back and the data follows
+	ok = 1;
+	for(n=1,i=EventIndex;n<EVENT_SIZE;n++,i=(i+1)%EVENT_SIZE){
+		if(CheckTime((i+1)%EVENT_SIZE)<CheckTime(i)) ok = 0;
+		if(EventTicks[(i+1)%EVENT_SIZE]<EventTicks[i]) ok = 0;
+		if(EventData1[(i+1)%EVENT_SIZE]!=EventData1[i]+1) ok = 0;
+	}
+	CHECK(ok);
+
+	// Across the carry of part 2 into part 1, without the background
+	// loop and its E_SYNC in between
+	SimRun((long)(TIME2_WRAP - SimTick - 2));
+	for(n=0;n<4;n++){
+		LogEvent(E_SETPOINT,-1-n,0.0);
+		SimIsr();
+	}
+	i = (EventIndex+EVENT_SIZE-1) % EVENT_SIZE;
+	CHECK(EventTime1[i]==1L && EventTime2[i]==TIME2_PER_TICK);
+	ok = 1;
+	for(n=0;n<3;n++,i=(i+EVENT_SIZE-1)%EVENT_SIZE){
+		if(CheckTime(i)!=CheckTime((i+EVENT_SIZE-1)%EVENT_SIZE)+1) ok = 0;
+		if(EventTime2[i]<0 || EventTime2[i]>=TIME2_WRAP*TIME2_PER_TICK) ok = 0;
+	}
+	CHECK(ok);
+
+	// Posted before part 2 carries, committed after, dated back across it
+	SimRun((long)(2*TIME2_WRAP - SimTick - 2));
+	tick = LogTickNow();
+	PostEvent(E_SETPOINT,-10,0.0);
+	for(n=0;n<5;n++) SimIsr();
+	CommitEvents();
+	i = (EventIndex+EVENT_SIZE-1) % EVENT_SIZE;
+	CHECK(EventData1[i]==-10 && EventTicks[i]==tick);
+	CHECK(EventTime1[i]==1L && EventTime2[i]==(TIME2_WRAP-2)*TIME2_PER_TICK);
+
+	// LogEvent commits what is staged first, the log stays in order
+	PostEvent(E_SETPOINT,-11,0.0);
+	LogEvent(E_SETPOINT,-12,0.0);
+	i = (EventIndex+EVENT_SIZE-1) % EVENT_SIZE;
+	CHECK(EventData1[i]==-12 && EventData1[(i+EVENT_SIZE-1)%EVENT_SIZE]==-11);
+
+	// A full queue drops the newest post and counts it
+	n = EventQLost;
+	first = EventIndex;
+	for(i=0;i<EVENT_QSIZE;i++) PostEvent(E_SETPOINT,i,0.0);
+	CHECK(EventQLost==n+1);
+	CommitEvents();
+	CHECK(EventIndex==(first+EVENT_QSIZE-1)%EVENT_SIZE);
+	i = (EventIndex+EVENT_SIZE-1) % EVENT_SIZE;
+	CHECK(EventData1[i]==EVENT_QSIZE-2);
+
+	// The 64-bit tick runs on past 2^32
+	lost = EventQLost;
+	LogTicks = 0xFFFFFFF0ULL;
+	for(i=0;i<10;i++){
+		SimRun(5);
+		PostEvent(E_SETPOINT,i,0.0);
+		SimBackground();
+	}
+	i = (EventIndex+EVENT_SIZE-1) % EVENT_SIZE;
+	CHECK(EventTicks[i]>0xFFFFFFFFULL);
+	ok = 1;
+	for(n=0;n<9;n++){
+		int a = (i+EVENT_SIZE-n-1) % EVENT_SIZE;
+		if(EventTicks[a]>=EventTicks[(a+1)%EVENT_SIZE]) ok = 0;
+	}
+	CHECK(ok);
+	CHECK(EventQLost==lost);
+}
+
+/** An E_SYNC record every EventSyncPeriod ticks pairs the wall clock with
+ *  the tick */
+static void CheckSync(void){
+
+	int from;
+	int count;
+	int ok;
+	int i;
+
+	SimInit();
+	from = EventIndex;
+	SimRun(3*EventSyncPeriod + 5);
+	count = 0;
+	ok = 1;
+	for(i=from;i!=EventIndex;i=(i+1)%EVENT_SIZE){
+		if(EventCode[i]!=E_SYNC) continue;
+		count++;
+		if(EventData1[i]!=LOG_SUBTICK_BITS) ok = 0;
+		if((unsigned long long)CheckTime(i)!=(EventTicks[i]>>LOG_SUBTICK_BITS)) ok = 0;
+	}
+	CHECK(count==3);
+	CHECK(ok);
+}
+
+/** A word flipped in a stored record fails its CRC, CheckEvents counts it
+ *  and finds the first one, also on a warm start */
+static void CheckCorrupt(void){
+
+	int i;
+	int k;
+	int n;
+
+	SimInit();
+	for(n=0;n<10;n++) LogEvent(E_SETPOINT,n,(float)n);
+	CHECK(CheckEvents()==0 && EventBad==0 && EventBadFirst==-1);
+
+	k = (EventIndex+EVENT_SIZE-3) % EVENT_SIZE;
+	EventData1[k] ^= 0x0100;
+	CHECK(CheckEvents()==1 && EventBad==1 && EventBadFirst==k);
+	i = (EventIndex+EVENT_SIZE-7) % EVENT_SIZE;
+	EventTicks[i] ^= 1ULL<<40;
+	CHECK(CheckEvents()==2 && EventBadFirst==(i<k ? i : k));
+	EventTicks[i] ^= 1ULL<<40;
+	EventData1[k] ^= 0x0100;
+	CHECK(CheckEvents()==0 && EventBadFirst==-1);
+
+	// A slot hit across a soft reset is flagged and the log kept
+	SimRun(2*SIM_BG_EVERY);
+	EventData2[k] = -EventData2[k] - 1.0;
+	SimSoftReset();
+	CHECK(EventWarm==1);
+	CHECK(EventBad==1 && EventBadFirst==k);
+}
+
+/** Decode the variable record at word k of EventVar by EventSchema into
+ *  v, returns its length in words or 0 when the length does not match the
+ *  schema */
+static int CheckVarDecode(int k, int *code, unsigned long long *tick, double *v){
+
+	union { float f; unsigned int u; } x;
+	const char *s;
+	unsigned long l;
+	int bare;
+	int len;
+	int j;
+	int n;
+	int i;
+
+	*code = (int)(EventVar[k]>>8);
+	len = (int)(EventVar[k] & 0xFF);
+	*tick = 0;
+	for(i=1;i<5;i++){
+		*tick = (*tick<<16) | EventVar[(k+i) & (EVENT_VAR_SIZE-1)];
+	}
+	bare = *code & EVENT_CODE_MASK;
+	if(bare>=EVENT_CODES) return 0;
+	j = 5;
+	n = 0;
+	for(s=EventSchema[bare];*s;s++){
+		l = EventVar[(k+j) & (EVENT_VAR_SIZE-1)];
+		j++;
+		if(*s!='i'){
+			l = (l<<16) | EventVar[(k+j) & (EVENT_VAR_SIZE-1)];
+			j++;
+		}
+		switch(*s){
+		case 'i':
+			v[n++] = (short)l;
+			break;
+		case 'l':
+			v[n++] = (long)(int)l;
+			break;
+		default:			// 'f'
+			x.u = (unsigned int)l;
+			v[n++] = x.f;
+			break;
+		}
+	}
+	return (len==j) ? len : 0;
+}
+
+/** LogParam, LogFlash and LogEventWords records decode by EventSchema, the
+ *  oldest whole records make room for new ones, the ring is kept over a
+ *  soft reset and a corrupt record header empties it */
+static void CheckVarEvents(void){
+
+	unsigned int w[5] = { 3, 0x3F80, 0x0000, 0xC000, 0x0000 };
+	unsigned long long tick;
+	unsigned long long last;
+	double v[8];
+	double id;
+	int code;
+	int count;
+	int head;
+	int ok;
+	int k;
+	int n;
+
+	SimInit();
+	SimRun(10);
+	LogParam(7, 1.5, -2.25);
+	SimRun(10);
+	LogFlash(2, 40, 0x12345678L);
+	LogEventWords(E_PARAM, w, 5);
+
+	k = EventVarTail;
+	n = CheckVarDecode(k, &code, &tick, v);
+	CHECK(n==10 && code==E_PARAM && v[0]==7 && v[1]==1.5 && v[2]==-2.25);
+	CHECK((tick>>LOG_SUBTICK_BITS)==10);
+	k = (k+n) & (EVENT_VAR_SIZE-1);
+	n = CheckVarDecode(k, &code, &tick, v);
+	CHECK(n==9 && code==E_FLASH && v[0]==2 && v[1]==40 && v[2]==0x12345678L);
+	CHECK((tick>>LOG_SUBTICK_BITS)==20);
+	k = (k+n) & (EVENT_VAR_SIZE-1);
+	n = CheckVarDecode(k, &code, &tick, v);
+	CHECK(n==10 && code==E_PARAM && v[0]==3 && v[1]==1.0 && v[2]==-2.0);
+	CHECK(((k+n) & (EVENT_VAR_SIZE-1))==EventVarHead);
+
+	// Out of range lengths are refused
+	head = EventVarHead;
+	LogEventWords(E_PARAM, w, -1);
+	LogEventWords(E_PARAM, w, 251);
+	CHECK(EventVarHead==head);
+
+	// Many more than fit, the newest whole records are kept in order
+	for(n=0;n<100;n++){
+		SimRun(1);
+		LogParam(n, (float)n, (float)-n);
+	}
+	count = 0;
+	ok = 1;
+	last = 0;
+	id = -1;
+	k = EventVarTail;
+	while(k!=EventVarHead){
+		n = CheckVarDecode(k, &code, &tick, v);
+		if(n!=10 || code!=E_PARAM || v[1]!=v[0] || v[2]!=-v[0] || tick<last) ok = 0;
+		if(n==0) break;
+		if(count>0 && v[0]!=id+1) ok = 0;
+		id = v[0];
+		last = tick;
+		count++;
+		k = (k+n) & (EVENT_VAR_SIZE-1);
+	}
+	CHECK(ok);
+	CHECK(count==(EVENT_VAR_SIZE-1)/10);
+	CHECK(id==99);
+
+	// Kept over a soft reset with the event log
+	head = EventVarHead;
+	k = EventVarTail;
+	SimSoftReset();
+	CHECK(EventWarm && EventVarHead==head && EventVarTail==k);
+	n = CheckVarDecode(k, &code, &tick, v);
+	CHECK(n==10 && code==E_PARAM && v[0]==100-count);
+
+	// A header no record can have empties the ring, at a soft reset and
+	// when room is made for a new record
+	EventVar[EventVarTail] &= 0xFF00;
+	SimSoftReset();
+	CHECK(EventWarm && EventVarHead==EventVarTail);
+	for(n=0;n<100;n++) LogParam(n, 0.0, 0.0);
+	EventVar[EventVarTail] &= 0xFF00;
+	LogParam(100, 0.0, 0.0);
+	CHECK(((EventVarHead - EventVarTail) & (EVENT_VAR_SIZE-1))==10);
+}
+
+/** A code masked off in EventMask is dropped by PostEvent, LogEvent and
+ *  LogEventWords, and a call site above EVENT_LEVEL is not built */
+static void CheckMask(void){
+
+	unsigned long mask;
+	unsigned long total;
+	int head;
+
+	SimInit();
+	CommitEvents();
+	mask = EventMask;
+	EventMask &= ~((1UL<<E_SETPOINT) | (1UL<<E_PARAM));
+	total = EventTotal;
+	head = EventVarHead;
+	PostEvent(E_SETPOINT,1,1.0);
+	CommitEvents();
+	LogEvent(E_SETPOINT,2,2.0);
+	LogParam(3,0.0,1.0);
+	CHECK(EventTotal==total && EventVarHead==head);
+
+	// Other codes still pass
+	LogEvent(E_STOP,4,4.0);
+	LogFlash(1,2,3L);
+	CHECK(EventTotal==total+1 && EventVarHead!=head);
+	EventMask = mask;
+	LogParam(3,0.0,1.0);
+	CHECK(EventVarHead!=head);
+
+	// The same calls built at a lower level
+#pragma push_macro("EVENT_LEVEL")
+#undef EVENT_LEVEL
+#define EVENT_LEVEL		EL_NORMAL
+	CHECK(E_SETPOINT_LEVEL > EVENT_LEVEL && E_STOP_LEVEL <= EVENT_LEVEL);
+	total = EventTotal;
+	POST_EVENT(E_SETPOINT,5,5.0);
+	LOG_EVENT(E_SETPOINT,6,6.0);
+	CommitEvents();
+	CHECK(EventTotal==total);
+	LOG_EVENT(E_STOP,7,7.0);
+	CHECK(EventTotal==total+1);
+#pragma pop_macro("EVENT_LEVEL")
+	POST_EVENT(E_SETPOINT,8,8.0);
+	CommitEvents();
+	CHECK(EventTotal==total+2);
+}
+
+/** A code tagged with an instance keeps its tag in EventCode and in the
+ *  variable record header, and shares the mask and counters of the code */
+static void CheckInstTags(void){
+
+	unsigned int w[5] = { 9, 0x4000, 0x0000, 0x3F00, 0x0000 };
+	unsigned long long tick;
+	unsigned long count;
+	unsigned long total;
+	unsigned long mask;
+	double v[8];
+	int code;
+	int i;
+
+	SimInit();
+	CommitEvents();
+	count = LogStats.EventCount[E_SETPOINT];
+	total = EventTotal;
+	LOG_EVENT_INST(E_SETPOINT,1,11,1.0);
+	POST_EVENT_INST(E_SETPOINT,3,12,2.0);
+	CommitEvents();
+	CHECK(EventTotal==total+2);
+	i = CheckFindEvent(EVENT_INST(E_SETPOINT,1),total);
+	CHECK(i>=0 && EventData1[i]==11 && EVENT_INST_OF(EventCode[i])==1);
+	i = CheckFindEvent(EVENT_INST(E_SETPOINT,3),total);
+	CHECK(i>=0 && EventData1[i]==12 && (EventCode[i] & EVENT_CODE_MASK)==E_SETPOINT);
+	CHECK(CheckFindEvent(E_SETPOINT,total)<0);
+	CHECK(EVENT_INST_OF(E_SETPOINT)==0);
+	CHECK(LogStats.EventCount[E_SETPOINT]==count+2);
+
+	// The header code byte carries the tag, the payload decodes as E_PARAM
+	LogEventWords(EVENT_INST(E_PARAM,2), w, 5);
+	i = (EventVarHead - 10) & (EVENT_VAR_SIZE-1);
+	CHECK(CheckVarDecode(i, &code, &tick, v)==10);
+	CHECK(code==EVENT_INST(E_PARAM,2) && EVENT_INST_OF(code)==2);
+	CHECK(v[0]==9 && v[1]==2.0 && v[2]==0.5);
+
+	// Masking the bare code drops it for every instance
+	mask = EventMask;
+	EventMask &= ~(1UL<<E_SETPOINT);
+	LogEvent(EVENT_INST(E_SETPOINT,2),13,3.0);
+	CHECK(EventTotal==total+2);
+	EventMask = mask;
+}
+
+/** Histogram bins a factor of 2 apart from 2^EVENT_HIST_MIN_EXP, counts
+ *  that saturate, the fault value binned, the counters over a soft reset,
+ *  and ClearStats */
+static void CheckStats(void){
+
+	static const LogStatsBlock zero;
+	unsigned long total;
+	int ok;
+	int b;
+
+	// A cold boot clears what the earlier checks counted
+	SimInit();
+	CommitEvents();
+	CHECK(LogStats.EventCount[E_STOP]==0 && LogStats.EventCount[E_SETPOINT]==0);
+	CHECK(LogStats.FaultCount[F_OVERCURRENT]==0);
+
+	// Bin 0 holds zero and everything below 2^EVENT_HIST_MIN_EXP
+	LogEvent(E_STOP,0,0.0);
+	LogEvent(E_STOP,0,0.01);
+	CHECK(LogStats.EventHist[E_STOP][0]==2);
+	ok = 1;
+	for(b=1;b<EVENT_HIST_BINS-1;b++){
+		LogEvent(E_STOP,0,ldexp(1.0,EVENT_HIST_MIN_EXP+b-1));
+		LogEvent(E_STOP,0,-0.99*ldexp(1.0,EVENT_HIST_MIN_EXP+b));
+		if(LogStats.EventHist[E_STOP][b]!=2) ok = 0;
+	}
+	CHECK(ok);
+	LogEvent(E_STOP,0,1e9);
+	CHECK(LogStats.EventHist[E_STOP][EVENT_HIST_BINS-1]==1);
+	CHECK(LogStats.EventCount[E_STOP]==2L*EVENT_HIST_BINS-1);
+
+	// Posts count when made, LogEventWords counts without a bin
+	total = LogStats.EventCount[E_SETPOINT];
+	PostEvent(E_SETPOINT,0,2.0);
+	CHECK(LogStats.EventCount[E_SETPOINT]==total+1);
+	CommitEvents();
+	CHECK(LogStats.EventCount[E_SETPOINT]==total+1);
+	LogParam(1,0.0,1.0);
+	CHECK(LogStats.EventCount[E_PARAM]==1 && LogStats.EventHist[E_PARAM][0]==0);
+
+	// A fault bins the value passed to Fault
+	SimInject(SimTick+1,1,F_OVERCURRENT,42.0);
+	SimRun(2);
+	CHECK(LogStats.FaultCount[F_OVERCURRENT]==1);
+	CHECK(LogStats.FaultHist[F_OVERCURRENT][5-EVENT_HIST_MIN_EXP+1]==1);
+
+	// Kept over a soft reset while they add up, cleared once they do not
+	SimSoftReset();
+	CHECK(EventWarm && LogStats.FaultCount[F_OVERCURRENT]==1);
+	CHECK(LogStats.EventCount[E_PARAM]==1);
+	LogStats.EventHist[E_PARAM][2]++;
+	SimSoftReset();
+	CHECK(EventWarm && LogStats.FaultCount[F_OVERCURRENT]==0);
+	CHECK(LogStats.EventCount[E_PARAM]==0 && LogStats.EventHist[E_PARAM][2]==0);
+
+	// Saturation
+	LogStats.EventCount[E_STOP] = 0xFFFFFFFEUL;
+	LogStats.EventHist[E_STOP][3] = 0xFFFE;
+	for(b=0;b<3;b++) LogEvent(E_STOP,0,ldexp(1.0,EVENT_HIST_MIN_EXP+2));
+	CHECK(LogStats.EventCount[E_STOP]==0xFFFFFFFFUL);
+	CHECK(LogStats.EventHist[E_STOP][3]==0xFFFF);
+
+	ClearStats();
+	CHECK(memcmp(&LogStats,&zero,sizeof(zero))==0);
+}
+
+/** A fault freezes the capture, and the capture and the event log are kept
+ *  over a soft reset */
+static void CheckFaultFreeze(void){
+
+	unsigned long long at;
+	unsigned long from;
+	unsigned long total;
+	int count;
+	int i;
+
+	SimInit();
+	CHECK(LogAuto==1 && LogChan==9);
+	LogTrigger = 1;
+	SimRun(5000);
+	CHECK(LogTrigger==1);
+	CHECK(mainState==READY && SimPwmOn);
+
+	from = EventTotal;
+	at = SimTick + 10;
+	SimInject(at,1,F_OVERCURRENT,42.0);
+	SimRun(20);
+	CHECK(mainState==FAULT);
+	CHECK(SimPwmOn==0 && SimPwmOff>=1);
+	CHECK(FaultActive(F_OVERCURRENT));
+	CHECK(LogTrigger==0);
+	i = CheckFindEvent(E_FAULT,from);
+	CHECK(i>=0 && EventData1[i]==F_OVERCURRENT && EventData2[i]==42.0);
+	CHECK(i>=0 && EventTicks[i]==at-1);
+	CHECK(i>=0 && CheckTime(i)==(long)(at-1));
+	i = CheckFindEvent(E_REACT,from);
+	CHECK(i>=0 && EventData1[i]==FC_DISABLE && EventData2[i]==F_OVERCURRENT);
+	CHECK(CheckFindEvent(E_STATE,from)>=0);
+
+	// Nothing more is recorded
+	memcpy(CheckSnap,LogBuf,sizeof(CheckSnap));
+	count = LogCount;
+	SimRun(3000);
+	CHECK(LogCount==count);
+	CHECK(memcmp(CheckSnap,LogBuf,sizeof(CheckSnap))==0);
+
+	// The sealed capture and the event log come back after a soft reset
+	SimRun(2*SIM_BG_EVERY);
+	total = EventTotal;
+	SimSoftReset();
+	CHECK(EventWarm==1);
+	CHECK(LogHold==1);
+	CHECK(LogCount==count);
+	CHECK(EventTotal>=total);
+	CHECK(CheckFindEvent(E_FAULT,from)>=0);
+	CHECK(memcmp(CheckSnap,LogBuf,sizeof(CheckSnap))==0);
+	SimRun(100);
+	LogTrigger = 1;
+	SimRun(100);
+	CHECK(memcmp(CheckSnap,LogBuf,sizeof(CheckSnap))==0);
+	i = (EventIndex+EVENT_SIZE-1) % EVENT_SIZE;
+	CHECK(EventTicks[i]>EventTicks[(i+EVENT_SIZE-1)%EVENT_SIZE] || EventTotal==total);
+
+	// Released, recording starts over
+	LogHold = 0;
+	LogTrigger = 0;
+	LogInit = 1;
+	SimRun(1);
+	LogTrigger = 1;
+	SimRun(100);
+	CHECK(LogHdrSamples==(unsigned long)(100/(LogSkip+1)));
+
+	// A header that fails its CRC starts cold
+	SimRun(2*SIM_BG_EVERY);
+	WarmEventCrc ^= 1;
+	SimSoftReset();
+	CHECK(EventWarm==0);
+	CHECK(LogHold==0);
+}
+
+/** Sample k of channel ch decoded by its LogHdrType, a LOG_Q15 sample
+ *  holds the _iq15 bits, the low 32 bits of the host long */
+static double CheckSample(int ch, int k){
+
+	union { float f; int q; } s;
+
+	s.f = LogBuf[ch*LogLength + k];
+	return (LogHdrType[ch]==LOG_Q15) ? s.q/32768.0 : s.f;
+}
+
+/** DefaultLog(2) logs the on-times as LOG_Q15 in the SVM_IQ build and as
+ *  LOG_FLOAT otherwise, every sample decodes to the on-time it took, and
+ *  the types hold over a soft reset with the capture */
+static void CheckLogQ15(void){
+
+	const int want = SVM_IQ ? LOG_Q15 : LOG_FLOAT;
+	svm_t v[3];
+	double on;
+	double e;
+	double worst = 0;
+	int n;
+	int i;
+
+	SimInit();
+	DefaultLog(2);
+	SimRun(1);
+	CHECK(LogChan==3*SVM_INSTANCES);
+	for(i=0;i<LogChan;i++) CHECK(LogHdrType[i]==want);
+	LogTrigger = 1;
+	for(n=0;n<LOG_SIZE/LogChan;n++){
+		on = 3750.0*n/(LOG_SIZE/LogChan) - 0.5;
+		v[0] = SvmInst[0].Out.OnA = SVM_FROMF(on);
+		v[1] = SvmInst[0].Out.OnB = SVM_FROMF(-on);
+		v[2] = SvmInst[0].Out.OnC = SVM_FROMF(on/7);
+		SimRun(1);
+		for(i=0;i<3;i++){
+			e = fabs(CheckSample(i,n) - SVM_TOF(v[i]));
+			if(e>worst) worst = e;
+		}
+	}
+	printf("log, DefaultLog(2), type %d, %d samples, worst decode error %.6f counts\n", want, n, worst);
+	CHECK(worst<1e-3);
+
+	// Sealed and held over a soft reset with its types
+	LogTrigger = 0;
+	SimRun(2*SIM_BG_EVERY);
+	SimSoftReset();
+	CHECK(LogHold==1);
+	for(i=0;i<LogChan;i++) CHECK(LogHdrType[i]==want);
+	LogHold = 0;
+}
+
+#if(EVENT_JOURNAL)
+/** Data of the newest replayed E_SETPOINT, ok cleared unless the replayed
+ *  ones count up by one */
+static int CheckJournalRun(int *ok){
+
+	int k = -1;
+	int i;
+
+	*ok = 1;
+	for(i=0;i<JOURNAL_RESTORE;i++){
+		if(EventCode[i]!=E_SETPOINT) continue;
+		if(k>=0 && EventData1[i]!=k+1) *ok = 0;
+		k = EventData1[i];
+	}
+	return k;
+}
+#endif
+
+/** After a power cycle the journal replays the newest events in order,
+ *  past a rotation of the sectors and past a record torn by a reset */
+static void CheckJournal(void){
+
+#if(EVENT_JOURNAL)
+	unsigned int rec[JOURNAL_REC_WORDS];
+	unsigned long total;
+	unsigned long boot;
+	int ok;
+	int i;
+	int n;
+
+	// Events the boot itself logs
+	SimInit();
+	boot = EventTotal;
+	for(n=0;n<20;n++){
+		SimRun(100);
+		LogEvent(E_SETPOINT,n,(float)n);
+	}
+	SimRun(1000);
+	total = EventTotal;
+
+	SimPowerCycle();
+	i = CheckFindEvent(E_SETPOINT,0L);
+	CHECK(i>=0 && EventData1[i]==0 && EventData2[i]==0.0);
+	CHECK(EventTotal==total+boot);
+
+	// Rotate through every sector, the newest records come back consecutive
+	SimInit();
+	for(n=0;n<JOURNAL_SECTORS*128+100;n++){
+		LogEvent(E_SETPOINT,n,0.0);
+		SimRun(SIM_BG_EVERY);
+	}
+	SimRun(10*SIM_BG_EVERY);
+	SimPowerCycle();
+	CHECK(EventTotal==JOURNAL_RESTORE+boot);
+	CHECK(CheckJournalRun(&ok)==JOURNAL_SECTORS*128+99 && ok);
+
+	// A record torn part way is skipped and the older ones replay
+	for(i=0;i<JOURNAL_REC_WORDS;i++) rec[i] = 0x1234;
+	NvWrite((long)JournalSector*JOURNAL_SECTOR_WORDS + (long)JournalSlot*JOURNAL_REC_WORDS, rec, JOURNAL_REC_WORDS-1);
+	SimPowerCycle();
+	CHECK(EventTotal==JOURNAL_RESTORE+boot);
+	CHECK(CheckJournalRun(&ok)==JOURNAL_SECTORS*128+99 && ok);
+#endif
+}
+
+/** Log and event checks */
+void CheckLog(void){
+
+	CheckLogWrap();
+	CheckHeader();
+	CheckEventWrap();
+	CheckSync();
+	CheckCorrupt();
+	CheckVarEvents();
+	CheckMask();
+	CheckInstTags();
+	CheckStats();
+	CheckFaultFreeze();
+	CheckLogQ15();
+	CheckJournal();
+}
@@ -0,0 +1,800 @@
+/**
+ * @file CheckSvm.c
+ * @brief Host checks of the space vector modulator.
+ *
+ * The UpdateSpaceVector wrapper over SpaceVector must give the on-times,
+ * vector times, sector and clip of the modulator it replaced, kept in
+ * SvmBase.c, on random points out into overmodulation: bit for bit in the
+ * linear range, and within CHECK_RECIP counts where the clip multiplies by
+ * SvmRecip in place of the divide.  SpaceVector
+ * called for two inputs in turn must give each the result it gives alone.
+ * The host build has two SvmInst, UpdateSpaceVectors must run each on its
+ * own inputs and leave the other and the globals alone.
+ *
+ * Every method must give the line-to-line on-times of symmetric SVM, and
+ * SVM_AUTO must change method only on the pass a new sector is entered,
+ * with the hysteresis of ClampOn and ClampOff, and no duty step within a
+ * sector.  Across the clamp boundaries of the discontinuous methods a
+ * compare may step by T0 and no more, six times a turn, and SVM_DPWM at
+ * Psi 0, pi/6 and pi/3 must be DPWM0, DPWM1 and DPWM2.  With OverMod the
+ * fundamental over a turn must follow |Vref| out to six-step, where the
+ * plain clip flattens at the hexagon.  On the simulated RL load at low
+ * speed, deadtime compensation from the measured or the reference current
+ * must cut the current THD of the uncompensated bridge.
+ *
+ * The Q15 build of SvmIq.c must stay within CHECK_IQ_BOUND counts of the
+ * float build over the alpha/beta plane, and its overmodulation
+ * fundamental within CHECK_IQ_FUND of the request.  Built with SVM_IQ 1
+ * the modulator of SVM.c is the Q15 one as well, so only the
+ * overmodulation fundamental and the deadtime run are checked there.
+ *
+ * StagePwm must saturate on-times to 0..Period and round them to nearest
+ * in both builds, and CommitPwm must write the three staged compares to
+ * their three registers and nothing else.  The minimum pulse stage must
+ * let no pulse between 0 and MinPulse out, in either build, and keep the
+ * running volt-seconds of each phase near the unlimited modulator.
+ */
+
+#include "Setup.h"
+#include "SVM.h"
+#include "SvmBase.h"
+#include "SvmIq.h"
+#include "Sim.h"
+#include "Check.h"
+
+#define CHECK_PERIOD	3750	/**< Checks, pwm period in counts */
+#define CHECK_POINTS	100000L	/**< Checks, random alpha/beta points */
+#define CHECK_RECIP		0.01	/**< Checks, on-time error bound of the reciprocal clip in counts */
+#define CHECK_FUND		0.0005	/**< Checks, overmodulation fundamental error bound */
+#define CHECK_GRID		500		/**< Checks, Q15 grid points per unit of alpha and beta */
+#define CHECK_IQ_BOUND	0.5		/**< Checks, Q15 on-time error bound in counts, linear range and clip */
+#define CHECK_IQ_FUND	0.001	/**< Checks, Q15 fundamental error bound in overmodulation */
+#define CHECK_DTC_HZ	2		/**< Checks, low speed of the deadtime checks, Hz */
+#define CHECK_DTC_TURNS	2		/**< Checks, electrical turns settled, then measured */
+#define CHECK_HARMONICS	25		/**< Checks, highest harmonic in the THD */
+
+static float CheckWave[CHECK_DTC_TURNS*SIM_RATE/CHECK_DTC_HZ];	// SimIa of the measured turns
+
+static unsigned long CheckSeed = 1;	// state of the random points
+
+/** Uniform random in -0.5 to 0.5 */
+static double CheckRand(void){
+
+	CheckSeed = CheckSeed*1103515245UL + 12345UL;
+	return (double)((CheckSeed>>16) & 0x7FFF) / 32768.0 - 0.5;
+}
+
+#if(!SVM_IQ)
+/** The wrapper against the previous UpdateSpaceVector, bit for bit unless
+ *  clipped */
+static void CheckBaseline(void){
+
+	float onA, onB, onC, tx, ty, t0, k;
+	int sector, clip;
+	double r, th, e;
+	double worst = 0;
+	long bad = 0;
+	long clipped = 0;
+	long i;
+
+	CheckSeed = 1;
+	SvmPeriod = CHECK_PERIOD;
+	SvmMethod = SVM_SYMMETRIC;
+	for(i=0;i<CHECK_POINTS;i++){
+		r = 1.3*(CheckRand()+0.5);
+		th = 2.0*M_PI*CheckRand();
+		SvmAlpha = r*cos(th);
+		SvmBeta = r*sin(th);
+		UpdateSpaceVectorBase();
+		onA = SvmOnA; onB = SvmOnB; onC = SvmOnC;
+		tx = SvmTx; ty = SvmTy; t0 = SvmT0; k = SvmK;
+		sector = SvmSector; clip = SvmClip;
+		SvmOnA = SvmOnB = SvmOnC = -1;
+		UpdateSpaceVector();
+		if(SvmSector!=sector || SvmClip!=clip) bad++;
+		else if(clip){
+			e = fabs(SvmOnA-onA);
+			if(fabs(SvmOnB-onB)>e) e = fabs(SvmOnB-onB);
+			if(fabs(SvmOnC-onC)>e) e = fabs(SvmOnC-onC);
+			if(e>worst) worst = e;
+			if(fabs(SvmK-k)>3e-7*k || SvmT0!=0) bad++;
+		}
+		else if(SvmOnA!=onA || SvmOnB!=onB || SvmOnC!=onC) bad++;
+		else if(SvmTx!=tx || SvmTy!=ty || SvmT0!=t0 || SvmK!=k) bad++;
+		clipped += clip;
+	}
+	printf("svm, wrapper against the previous modulator, %ld of %ld points differ, %ld clipped within %.4f counts\n",
+			bad, CHECK_POINTS, clipped, worst);
+	CHECK(bad==0);
+	CHECK(worst<=CHECK_RECIP);
+	CHECK(clipped>0 && clipped<CHECK_POINTS);
+}
+
+/** Two inputs in turn through one SpaceVector, no state carried over */
+static void CheckReentrant(void){
+
+	SvmInputs a = {0};
+	SvmInputs b;
+	SvmOutputs oa, ob, alone;
+
+	a.Period = CHECK_PERIOD;
+	a.Method = SVM_SYMMETRIC;
+	b = a;
+	a.Alpha = 0.3;
+	a.Beta = 0.4;
+	b.Alpha = -0.7;
+	b.Beta = -0.5;
+	SpaceVector(&a, &alone);
+	SpaceVector(&a, &oa);
+	SpaceVector(&b, &ob);
+	CHECK(oa.OnA==alone.OnA && oa.OnB==alone.OnB && oa.OnC==alone.OnC);
+	CHECK(oa.Sector==1 && ob.Sector==4);
+	SpaceVector(&b, &alone);
+	SpaceVector(&a, &oa);
+	CHECK(ob.OnA==alone.OnA && ob.OnB==alone.OnB && ob.OnC==alone.OnC);
+	CHECK(ob.Clip==alone.Clip && ob.K==alone.K);
+}
+
+/** UpdateSpaceVectors, each instance from its own inputs */
+static void CheckInstances(void){
+
+	SvmOutputs a, b;
+	float onA = SvmOnA;
+
+	SvmInst[0].In.Alpha = 0.3;
+	SvmInst[0].In.Beta = 0.4;
+	SvmInst[0].In.Period = CHECK_PERIOD;
+	SvmInst[0].In.Method = SVM_SYMMETRIC;
+	SvmInst[1].In = SvmInst[0].In;
+	SvmInst[1].In.Alpha = -0.9;
+	SvmInst[1].In.Beta = 0.6;
+	SvmInst[1].In.Period = 2*CHECK_PERIOD;
+	UpdateSpaceVectors();
+	SpaceVector(&SvmInst[0].In, &a);
+	SpaceVector(&SvmInst[1].In, &b);
+	CHECK(SvmInst[0].Out.OnA==a.OnA && SvmInst[0].Out.OnB==a.OnB && SvmInst[0].Out.OnC==a.OnC);
+	CHECK(SvmInst[1].Out.OnA==b.OnA && SvmInst[1].Out.OnB==b.OnB && SvmInst[1].Out.OnC==b.OnC);
+	CHECK(SvmInst[0].Out.Sector==1 && SvmInst[1].Out.Sector==3);
+	CHECK(SvmInst[0].Out.Clip==0 && SvmInst[1].Out.Clip==1);
+
+	// A new reference for one bridge leaves the other as it was
+	SvmInst[1].In.Alpha = 0.1;
+	SvmInst[1].In.Beta = -0.2;
+	UpdateSpaceVectors();
+	CHECK(SvmInst[0].Out.OnA==a.OnA && SvmInst[0].Out.OnB==a.OnB && SvmInst[0].Out.OnC==a.OnC);
+	CHECK(SvmInst[1].Out.Sector==5 && SvmInst[1].Out.OnA!=b.OnA);
+	CHECK(SvmOnA==onA);
+}
+
+/** Every method gives the line-to-line on-times of symmetric SVM */
+static void CheckVoltSeconds(void){
+
+	static const double mags[3] = { 0.2, 0.5, 0.8 };
+	SvmInputs in = {0};
+	SvmInputs ref;
+	SvmOutputs o = {0}, r = {0};
+	double th;
+	double e;
+	double worst = 0;
+	int method;
+	int m;
+	int i;
+
+	in.Period = CHECK_PERIOD;
+	in.Method = SVM_SYMMETRIC;
+	in.ClampOn = 0.75;
+	in.ClampOff = 0.65;
+	SvmSetPsi(&in, 0.4);
+	ref = in;
+	for(method=SVM_SYMMETRIC+1;method<=SVM_DPWM;method++){
+		for(m=0;m<3;m++){
+			in.Method = method;
+			for(i=0;i<3600;i++){
+				th = i*M_PI/1800.0 + 1e-4;
+				in.Alpha = ref.Alpha = mags[m]*cos(th);
+				in.Beta = ref.Beta = mags[m]*sin(th);
+				SpaceVector(&in, &o);
+				SpaceVector(&ref, &r);
+				e = fabs((o.OnA-o.OnB) - (r.OnA-r.OnB));
+				if(e>worst) worst = e;
+				e = fabs((o.OnB-o.OnC) - (r.OnB-r.OnC));
+				if(e>worst) worst = e;
+			}
+		}
+	}
+	printf("svm, methods 2-9 against symmetric, line-to-line worst %.4f counts\n", worst);
+	CHECK(worst<0.01);
+}
+
+/** SVM_AUTO over a slow |Vref| ramp up through ClampOn and back down
+ *  through ClampOff while the vector turns, 100 passes a sector.  The
+ *  method may only change on a pass that enters a new sector, and within
+ *  a sector no phase may step by more than the turn of one pass, some
+ *  40 counts, where a clamp change would step it by a few hundred. */
+static void CheckAuto(void){
+
+	SvmInputs in = {0};
+	SvmOutputs o = {0};
+	double mag, th;
+	double step;
+	double worst = 0;
+	float onA = 0, onB = 0, onC = 0;
+	int sector = 0, active = 0;
+	int midsector = 0;
+	int up = 0, down = 0;
+	int early = 0;
+	long i;
+
+	in.Period = CHECK_PERIOD;
+	in.Method = SVM_AUTO;
+	in.ClampOn = 0.75;
+	in.ClampOff = 0.65;
+	for(i=0;i<12000;i++){
+		mag = i<6000 ? 0.5 + 0.35*i/6000.0 : 0.85 - 0.35*(i-6000)/6000.0;
+		th = i*M_PI/300.0 + 1e-4;
+		in.Alpha = mag*cos(th);
+		in.Beta = mag*sin(th);
+		SpaceVector(&in, &o);
+		if(i>0 && o.Active!=active){
+			if(o.Sector==sector) midsector++;
+			if(o.Active==SVM_CLAMP_ODD){
+				up++;
+				if(mag<=in.ClampOn) early++;
+			}
+			else{
+				down++;
+				if(mag>=in.ClampOff) early++;
+			}
+		}
+		if(i>0 && o.Sector==sector){
+			step = fabs(o.OnA-onA);
+			if(fabs(o.OnB-onB)>step) step = fabs(o.OnB-onB);
+			if(fabs(o.OnC-onC)>step) step = fabs(o.OnC-onC);
+			if(step>worst) worst = step;
+		}
+		onA = o.OnA; onB = o.OnB; onC = o.OnC;
+		sector = o.Sector;
+		active = o.Active;
+	}
+	printf("svm, auto ramp, %d up and %d down, %d mid-sector, largest in-sector step %.1f counts\n",
+			up, down, midsector, worst);
+	CHECK(up==1 && down==1);
+	CHECK(midsector==0 && early==0);
+	CHECK(active==SVM_SYMMETRIC);
+	CHECK(worst<0.02*CHECK_PERIOD);
+}
+
+/** Largest phase on-time step of two passes */
+static double CheckStep(const SvmOutputs *a, const SvmOutputs *b){
+
+	double e = fabs(a->OnA - b->OnA);
+
+	if(fabs(a->OnB - b->OnB)>e) e = fabs(a->OnB - b->OnB);
+	if(fabs(a->OnC - b->OnC)>e) e = fabs(a->OnC - b->OnC);
+	return e;
+}
+
+/** The discontinuous methods over a turn at |Vref| 0.7, 3600 passes.
+ *  A clamp change moves the zero-vector share k0 between 0 and 1, so a
+ *  compare may step by T0 of the pass there, and by one pass of rotation
+ *  everywhere else. */
+static void CheckDpwm(void){
+
+	static const int methods[7] = { SVM_DPWM0, SVM_DPWM2, SVM_DPWMMIN, SVM_DPWMMAX,
+			SVM_DPWM1, SVM_DPWM3, SVM_DPWM };
+	static const int same[3] = { SVM_DPWM0, SVM_DPWM1, SVM_DPWM2 };
+	SvmInputs in = {0};
+	SvmInputs ref;
+	SvmOutputs o, r;
+	SvmOutputs p = {0};
+	double th;
+	double step;
+	double smooth = 0;
+	double flip = 0;
+	double worst = 0;
+	int steps;
+	int m;
+	long i;
+
+	in.Period = CHECK_PERIOD;
+	SvmSetPsi(&in, 0.4);
+	for(m=0;m<7;m++){
+		in.Method = methods[m];
+		steps = 0;
+		for(i=0;i<=3600;i++){
+			th = i*M_PI/1800.0 + 1e-4;
+			in.Alpha = 0.7*cos(th);
+			in.Beta = 0.7*sin(th);
+			SpaceVector(&in, &o);
+			if(i>0){
+				step = CheckStep(&o, &p);
+				if(step>0.05*CHECK_PERIOD){
+					steps++;
+					step = fabs(step - o.T0*CHECK_PERIOD);
+					if(step>flip) flip = step;
+				}
+				else if(step>smooth) smooth = step;
+			}
+			p = o;
+		}
+		CHECK(steps==(in.Method==SVM_DPWMMIN || in.Method==SVM_DPWMMAX ? 0 : 6));
+	}
+	printf("svm, dpwm turn, steps off T0 by %.1f counts at the clamp boundaries, %.1f counts elsewhere\n",
+			flip, smooth);
+	CHECK(flip<0.01*CHECK_PERIOD);
+	CHECK(smooth<0.01*CHECK_PERIOD);
+
+	for(m=0;m<3;m++){
+		in.Method = SVM_DPWM;
+		SvmSetPsi(&in, m*SVM_PI3/2);
+		ref = in;
+		ref.Method = same[m];
+		for(i=0;i<3600;i++){
+			th = i*M_PI/1800.0 + 1e-4;
+			in.Alpha = ref.Alpha = 0.7*cos(th);
+			in.Beta = ref.Beta = 0.7*sin(th);
+			SpaceVector(&in, &o);
+			SpaceVector(&ref, &r);
+			step = CheckStep(&o, &r);
+			if(step>worst) worst = step;
+		}
+	}
+	printf("svm, SVM_DPWM at Psi 0, pi/6 and pi/3 against DPWM0, 1 and 2, worst %.4f counts\n", worst);
+	CHECK(worst<0.01);
+
+	// The wrapper takes new sines when SvmPsi moves
+	SvmPeriod = CHECK_PERIOD;
+	SvmMethod = SVM_DPWM;
+	SvmAlpha = 0.7*cos(0.5);
+	SvmBeta = 0.7*sin(0.5);
+	for(m=0;m<3;m+=2){
+		SvmPsi = m*SVM_PI3/2;
+		UpdateSpaceVector();
+		in.Method = same[m];
+		in.Alpha = SvmAlpha;
+		in.Beta = SvmBeta;
+		SpaceVector(&in, &r);
+		CHECK(fabs(SvmOnA-r.OnA)<0.01 && fabs(SvmOnB-r.OnB)<0.01 && fabs(SvmOnC-r.OnC)<0.01);
+	}
+	SvmPsi = 0.5235988;
+	SvmMethod = SVM_SYMMETRIC;
+}
+
+/** Fundamental of the phase on-times over a turn at |Vref| r */
+static double CheckFundamental(SvmInputs *in, double r, int *mode){
+
+	SvmOutputs o = {0};
+	double th, va, vb, vc;
+	double re = 0;
+	int i;
+
+	for(i=0;i<3600;i++){
+		th = 2.0*M_PI*i/3600;
+		in->Alpha = r*cos(th);
+		in->Beta = r*sin(th);
+		SpaceVector(in, &o);
+		va = o.OnA/in->Period;
+		vb = o.OnB/in->Period;
+		vc = o.OnC/in->Period;
+		re += (2*va-vb-vc)/2.0*cos(th) + (vb-vc)*SVM_SQRT3_2*sin(th);
+		if(o.OverMode>*mode) *mode = o.OverMode;
+	}
+	return re/3600;
+}
+
+/** Overmodulation from the inscribed circle out past six-step, the
+ *  fundamental against the request and the mode reported on the way */
+static void CheckOverMod(void){
+
+	SvmInputs in = {0};
+	double r, f, want;
+	double worst = 0;
+	double clip = 0;
+	int mode;
+	int bad = 0;
+
+	in.Period = CHECK_PERIOD;
+	in.Method = SVM_SYMMETRIC;
+	in.OverMod = 1;
+	for(r=0.80;r<1.0;r+=0.005){
+		mode = 0;
+		f = CheckFundamental(&in, r, &mode);
+		want = (r<SVM_SIX_STEP) ? r : SVM_SIX_STEP;
+		if(fabs(f-want)>worst) worst = fabs(f-want);
+		if(mode!=(r<SVM_LINEAR ? 0 : r*r<SVM_OM_HEX2 ? 1 : 2)) bad++;
+	}
+	in.OverMod = 0;
+	mode = 0;
+	clip = CheckFundamental(&in, SVM_SIX_STEP, &mode);
+	printf("svm, overmodulation fundamental worst error %.5f, plain clip %.4f at six-step\n", worst, clip);
+	CHECK(worst<=CHECK_FUND);
+	CHECK(bad==0 && mode==0);
+	CHECK(clip<0.91 && clip>0.90);
+}
+
+#endif
+
+/** Default float view, symmetric, no compensation, no pulse limit */
+static void CheckDefaults(SvmIqIn *v){
+
+	SvmIqIn zero = {0};
+
+	*v = zero;
+	v->Period = CHECK_PERIOD;
+	v->Method = SVM_SYMMETRIC;
+	v->ClampOn = 0.75;
+	v->ClampOff = 0.65;
+	v->Psi = 0.4;
+}
+
+#if(!SVM_IQ)
+/** Float inputs from the float view shared with the Q15 build */
+static void CheckInputs(const SvmIqIn *v, SvmInputs *in){
+
+	in->Alpha = v->Alpha;
+	in->Beta = v->Beta;
+	in->Period = v->Period;
+	in->Method = v->Method;
+	in->ClampOn = v->ClampOn;
+	in->ClampOff = v->ClampOff;
+	SvmSetPsi(in, v->Psi);
+	in->OverMod = v->OverMod;
+	in->DtcMode = v->DtcMode;
+	in->Dtc = v->Dtc;
+	in->DtcBand = v->DtcBand;
+	in->Ia = v->Ia;
+	in->Ib = v->Ib;
+	in->Ic = v->Ic;
+	in->IAlpha = v->IAlpha;
+	in->IBeta = v->IBeta;
+	in->MinMode = v->MinMode;
+	in->MinPulse = v->MinPulse;
+}
+
+/** Largest on-time difference of two results */
+static double CheckDiff(const SvmOutputs *f, const SvmIqOut *q){
+
+	double e = fabs(f->OnA - q->OnA);
+
+	if(fabs(f->OnB - q->OnB)>e) e = fabs(f->OnB - q->OnB);
+	if(fabs(f->OnC - q->OnC)>e) e = fabs(f->OnC - q->OnC);
+	return e;
+}
+
+/** Q15 against float over a grid of the alpha/beta plane out to +/-1.2,
+ *  for every method, clip and overmodulation, and each deadtime mode.
+ *  A point on an exact sector or clamp tie, where both builds are right
+ *  but pick different sides, is taken at the nearest untied neighbour. */
+static void CheckIqBound(void){
+
+	SvmIqIn v;
+	SvmInputs in, near;
+	SvmOutputs zero = {0};
+	SvmOutputs o, p;
+	SvmIqOut q;
+	double e, en;
+	double lin = 0;
+	long points = 0;
+	int method, om, dtc;
+	int i, j, k;
+
+	for(method=SVM_SYMMETRIC;method<=SVM_DPWM;method++){
+		if(method==SVM_AUTO) continue;		// state dependent, covered by 2 and 1
+		for(om=0;om<2;om++){
+			for(dtc=SVM_DTC_OFF;dtc<=SVM_DTC_REF;dtc++){
+				for(i=-6*CHECK_GRID/5;i<=6*CHECK_GRID/5;i++){
+					for(j=-6*CHECK_GRID/5;j<=6*CHECK_GRID/5;j++){
+						CheckDefaults(&v);
+						v.Method = method;
+						v.OverMod = om;
+						v.DtcMode = dtc;
+						v.Dtc = 40.0;
+						v.DtcBand = 0.1;
+						v.Alpha = (float)i/CHECK_GRID;
+						v.Beta = (float)j/CHECK_GRID;
+						v.Ia = 0.3*cos(7.0*v.Alpha);
+						v.Ib = 0.3*sin(5.0*v.Beta);
+						v.Ic = -v.Ia - v.Ib;
+						v.IAlpha = 0.2*v.Alpha;
+						v.IBeta = 0.2*v.Beta;
+						// Mode II is steep near six-step, its bound is the fundamental below
+						if(om && v.Alpha*v.Alpha+v.Beta*v.Beta>=SVM_OM_LIN2) continue;
+						CheckInputs(&v, &in);
+						SvmIqReset(0);
+						SvmIqRun(0, &v, &q);
+						o = zero;
+						SpaceVector(&in, &o);
+						e = CheckDiff(&o, &q);
+						if(e>CHECK_IQ_BOUND){
+							for(k=0;k<4;k++){
+								near = in;
+								near.Alpha += (k&1) ? 6e-5 : -6e-5;
+								near.Beta += (k&2) ? 6e-5 : -6e-5;
+								p = zero;
+								SpaceVector(&near, &p);
+								en = CheckDiff(&p, &q);
+								if(en<e) e = en;
+							}
+						}
+						if(e>lin) lin = e;
+						points++;
+					}
+				}
+			}
+		}
+	}
+	printf("q15, %ld grid points, worst on-time error %.3f counts\n", points, lin);
+	CHECK(lin<=CHECK_IQ_BOUND);
+}
+#endif
+
+/** Q15 fundamental over a turn in overmodulation, the fraction of an
+ *  active vector it falls short of or exceeds the request */
+static void CheckIqFundamental(void){
+
+	SvmIqIn v;
+	SvmIqOut q;
+	double r, th, want, re, va, vb, vc;
+	double worst = 0;
+	int i;
+
+	for(r=0.80;r<1.0;r+=0.005){
+		CheckDefaults(&v);
+		v.OverMod = 1;
+		SvmIqReset(0);
+		re = 0;
+		for(i=0;i<3600;i++){
+			th = 2.0*M_PI*i/3600;
+			v.Alpha = r*cos(th);
+			v.Beta = r*sin(th);
+			SvmIqRun(0, &v, &q);
+			va = q.OnA/CHECK_PERIOD;
+			vb = q.OnB/CHECK_PERIOD;
+			vc = q.OnC/CHECK_PERIOD;
+			re += (2*va-vb-vc)/2.0*cos(th) + (vb-vc)*(SVM_SQRT3_2)*sin(th);
+		}
+		want = (r<SVM_SIX_STEP) ? r : SVM_SIX_STEP;
+		if(fabs(re/3600-want)>worst) worst = fabs(re/3600-want);
+	}
+	printf("q15, overmodulation fundamental worst error %.5f\n", worst);
+	CHECK(worst<=CHECK_IQ_FUND);
+}
+
+#if(!SVM_IQ)
+/** Minimum pulse stage on a random trajectory, in both builds.  No pulse
+ *  between 0 and MinPulse goes out, and the running volt-seconds of each
+ *  phase stay within MinPulse (clamp) or MinPulse/2 (drop) of the
+ *  unlimited modulator. */
+static void CheckMinPulse(void){
+
+	const double period = 1000.0;
+	const double min = 25.0;
+	SvmIqIn v, u;
+	SvmInputs in, ref;
+	SvmOutputs o = {0}, r = {0};
+	SvmIqOut q, qr;
+	double on[6], want[6], sum[6], dev;
+	double a = 0, b = 0;
+	double bound;
+	long narrow;
+	long n;
+	int mode;
+	int k;
+
+	for(mode=SVM_MIN_CLAMP;mode<=SVM_MIN_DROP;mode++){
+		CheckDefaults(&v);
+		v.Period = (int)period;
+		u = v;
+		v.MinMode = mode;
+		v.MinPulse = min;
+		CheckInputs(&v, &in);
+		CheckInputs(&u, &ref);
+		SvmIqReset(0);
+		SvmIqReset(1);
+		CheckSeed = 3;
+		for(k=0;k<6;k++) sum[k] = 0;
+		narrow = 0;
+		dev = 0;
+		for(n=0;n<200000L;n++){
+			a += CheckRand()*0.02;
+			b += CheckRand()*0.02;
+			if(a*a+b*b>0.8){
+				a *= 0.9;
+				b *= 0.9;
+			}
+			v.Alpha = u.Alpha = in.Alpha = ref.Alpha = a;
+			v.Beta = u.Beta = in.Beta = ref.Beta = b;
+			SpaceVector(&in, &o);
+			SpaceVector(&ref, &r);
+			SvmIqRun(0, &v, &q);
+			SvmIqRun(1, &u, &qr);
+			on[0] = o.OnA; on[1] = o.OnB; on[2] = o.OnC;
+			on[3] = q.OnA; on[4] = q.OnB; on[5] = q.OnC;
+			want[0] = r.OnA; want[1] = r.OnB; want[2] = r.OnC;
+			want[3] = qr.OnA; want[4] = qr.OnB; want[5] = qr.OnC;
+			for(k=0;k<6;k++){
+				if((on[k]>1e-3 && on[k]<min-1e-3) || (on[k]<period-1e-3 && on[k]>period-min+1e-3)) narrow++;
+				sum[k] += on[k] - want[k];
+				if(fabs(sum[k])>dev) dev = fabs(sum[k]);
+			}
+		}
+		bound = (mode==SVM_MIN_CLAMP) ? min : min/2;
+		printf("svm, min pulse mode %d, %ld narrow pulses, running volt-second error %.3f counts\n", mode, narrow, dev);
+		CHECK(narrow==0);
+		CHECK(dev<=bound+0.05);
+	}
+}
+#endif
+
+/** 1 when c is the nearest count to an on-time of x counts saturated to
+ *  0..period, a tie within the resolution of the build either way */
+static int CheckCounts(unsigned int c, double x, int period){
+
+	svm_t held = SVM_FROMF(x);		// the on-time as the build holds it
+
+	x = SVM_TOF(held);
+	if(x>period) x = period;
+	if(x<0) x = 0;
+	return fabs(x - c) <= 0.5 + 1e-3;
+}
+
+/** StagePwm rounding and clamps, CommitPwm stores, the staging of both
+ *  wrappers and the commit of the sim ISR */
+static void CheckPwm(void){
+
+	static const double on[6] = { -3.0, 0.0, 1874.49, 1874.5, 3750.0, 3750.7 };
+	static const unsigned int want[6] = { 0, 0, 1874, 1875, 3750, 3750 };
+	SvmOutputs o = {0};
+	SvmCompare c;
+	volatile unsigned int regs[5];
+	double x;
+	long bad = 0;
+	long moved = 0;
+	long i;
+
+	for(i=0;i<6;i+=3){
+		o.OnA = SVM_FROMF(on[i]);
+		o.OnB = SVM_FROMF(on[i+1]);
+		o.OnC = SVM_FROMF(on[i+2]);
+		StagePwm(&o, CHECK_PERIOD, &c);
+		CHECK(c.CmpA==want[i] && c.CmpB==want[i+1] && c.CmpC==want[i+2]);
+	}
+	CheckSeed = 7;
+	for(i=0;i<CHECK_POINTS;i++){
+		x = (CHECK_PERIOD+200.0)*(CheckRand()+0.5) - 100.0;
+		o.OnA = SVM_FROMF(x);
+		o.OnB = SVM_FROMF(CHECK_PERIOD - x);
+		o.OnC = SVM_FROMF(x/2);
+		StagePwm(&o, CHECK_PERIOD, &c);
+		if(!CheckCounts(c.CmpA, x, CHECK_PERIOD)) bad++;
+		if(!CheckCounts(c.CmpB, CHECK_PERIOD - x, CHECK_PERIOD)) bad++;
+		if(!CheckCounts(c.CmpC, x/2, CHECK_PERIOD)) bad++;
+	}
+	printf("svm, StagePwm, %ld of %ld random on-times not staged as the nearest count\n", bad, 3*CHECK_POINTS);
+	CHECK(bad==0);
+
+	// Three stores, each to its own register, the neighbours untouched
+	for(i=0;i<5;i++) regs[i] = 0xFFFF;
+	c.CmpA = 11;
+	c.CmpB = 22;
+	c.CmpC = 33;
+	CommitPwm(&c, &regs[1], &regs[2], &regs[3]);
+	CHECK(regs[0]==0xFFFF && regs[1]==11 && regs[2]==22 && regs[3]==33 && regs[4]==0xFFFF);
+
+	// Both wrappers stage what they computed
+	SvmPeriod = CHECK_PERIOD;
+	SvmMethod = SVM_SYMMETRIC;
+	SvmAlpha = 0.3;
+	SvmBeta = -0.45;
+	UpdateSpaceVector();
+	CHECK(CheckCounts(SvmCmp.CmpA, SvmOnA, CHECK_PERIOD));
+	CHECK(CheckCounts(SvmCmp.CmpB, SvmOnB, CHECK_PERIOD));
+	CHECK(CheckCounts(SvmCmp.CmpC, SvmOnC, CHECK_PERIOD));
+	UpdateSpaceVectors();
+	for(i=0;i<SVM_INSTANCES;i++){
+		StagePwm(&SvmInst[i].Out, SvmInst[i].In.Period, &c);
+		CHECK(SvmInst[i].Cmp.CmpA==c.CmpA && SvmInst[i].Cmp.CmpB==c.CmpB && SvmInst[i].Cmp.CmpC==c.CmpC);
+	}
+
+	// The sim ISR commits at the start of a pass what the pass before
+	// staged, on the load reference the set moves every pass
+	SimInit();
+	SimLoad = 1;
+	SimRun(10);
+	for(i=0;i<100;i++){
+		c = SvmCmp;
+		SimRun(1);
+		if(SimCmpA!=c.CmpA || SimCmpB!=c.CmpB || SimCmpC!=c.CmpC) bad++;
+		if(SvmCmp.CmpA!=c.CmpA || SvmCmp.CmpB!=c.CmpB || SvmCmp.CmpC!=c.CmpC) moved++;
+	}
+	printf("svm, sim ISR, %ld of 100 commits not the set staged before, set moved %ld times\n", bad, moved);
+	CHECK(bad==0 && moved>=90);
+	SimLoad = 0;
+	SimInit();
+}
+
+/** THD of n samples of whole turns, harmonics 2 to CHECK_HARMONICS */
+static double CheckThd(const float *x, long n, int turns){
+
+	double re, im, p1 = 0, ph = 0;
+	int h;
+	long i;
+
+	for(h=1;h<=CHECK_HARMONICS;h++){
+		re = im = 0;
+		for(i=0;i<n;i++){
+			re += x[i]*cos(2.0*M_PI*h*turns*i/n);
+			im += x[i]*sin(2.0*M_PI*h*turns*i/n);
+		}
+		if(h==1) p1 = re*re + im*im;
+		else ph += re*re + im*im;
+	}
+	return sqrt(ph/p1);
+}
+
+/** SimRun on the RL load at CHECK_DTC_HZ, phase A current THD of one
+ *  deadtime compensation setting */
+static double CheckDtcRun(int mode, float band){
+
+	long n = sizeof(CheckWave)/sizeof(CheckWave[0]);
+	long i;
+
+	SimInit();
+	SvmDtcMode = mode;
+	SvmDtc = SimDead;
+	SvmDtcBand = band;
+	SimRun(n);
+	for(i=0;i<n;i++){
+		SimRun(1);
+		CheckWave[i] = SimIa;
+	}
+	return CheckThd(CheckWave, n, CHECK_DTC_TURNS);
+}
+
+/** Deadtime compensation against SVM_DTC_OFF at low speed, 40 counts of
+ *  deadtime that saturates at SIM_LOAD_SAT, and noise on the measured
+ *  currents of a fifth of the peak */
+static void CheckDeadtime(void){
+
+	double off, sign, meas, ref;
+
+	SimSpeed = CHECK_DTC_HZ;
+	SimLoad = 1;
+	SimVref = 0.05;
+	SimDead = 40.0;
+	SimINoise = 0.06;
+	off = CheckDtcRun(SVM_DTC_OFF, 0);
+	sign = CheckDtcRun(SVM_DTC_MEAS, 0);
+	meas = CheckDtcRun(SVM_DTC_MEAS, SIM_LOAD_SAT);
+	ref = CheckDtcRun(SVM_DTC_REF, SIM_LOAD_SAT);
+	printf("svm, deadtime at %d Hz, THD %.1f%% off, %.1f%% sign test, %.1f%% measured, %.1f%% reference\n",
+			CHECK_DTC_HZ, 100*off, 100*sign, 100*meas, 100*ref);
+	CHECK(meas<off/2 && ref<off/4);
+	CHECK(meas<sign && ref<meas);
+	SimLoad = 0;
+	SimDead = SimINoise = 0;
+	SimSpeed = 50.0;
+	SvmDtcMode = SVM_DTC_OFF;
+	SvmDtc = 0;
+	SvmDtcBand = 0.1;
+	SimInit();
+}
+
+/** Modulator checks */
+void CheckSvm(void){
+
+#if(!SVM_IQ)
+	CheckBaseline();
+	CheckReentrant();
+	CheckInstances();
+	CheckVoltSeconds();
+	CheckAuto();
+	CheckDpwm();
+	CheckOverMod();
+	CheckIqBound();
+	CheckMinPulse();
+#endif
+	CheckIqFundamental();
+	CheckDeadtime();
+	CheckPwm();
+}
@@ -0,0 +1,332 @@
+/**
+ * @file CheckXfer.c
+ * @brief Host loopback checks of the CAN block transfer.
+ *
+ * The simulated target binds the Unix datagram socket CHECK_LINK with
+ * XferHostOpen and the receiver of XferTool.c reads it from the same
+ * process, running the target while it waits.  The words that arrive are
+ * compared with the memory they came from, in the target widths of every
+ * region, with and without lost frames, from an offset and over vcan0 when
+ * that interface exists.  Channel addresses go by their offset from
+ * &LogAddr0.  A link that fails to open must not keep its socket.
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include "Setup.h"
+#include "Sim.h"
+#include "Check.h"
+#include "XferTool.h"
+
+#ifndef CHECK_LINK
+#define CHECK_LINK	"unix:xfer.sock"	/**< Checks, link the simulated target serves */
+#endif
+
+// LogXfer.c state read by the checks
+extern unsigned int XferFrames;
+extern int XferResends;
+extern int XferQLost;
+extern unsigned long LogHdrSamples;
+extern unsigned long long LogHdrStart;
+extern int LogHdrPeriod;
+extern int LogHdrTrigger;
+extern unsigned long long LogHdrTrigTick;
+extern int LogMarkIndex;
+extern unsigned long LogMarkSample[];
+extern unsigned long long LogMarkTick[];
+extern int LogMarkPeriod[];
+extern int EventVarHead;
+extern int EventVarTail;
+extern unsigned int EventCrc[];
+extern unsigned int EventVar[];
+
+static unsigned short CheckWords[2*LOG_SIZE];	// LogBuf as read
+
+/** Run the target while the receiver waits */
+static void CheckIdle(void){
+
+	SimRun(SIM_BG_EVERY);
+}
+
+/** 1 when the words read are LogBuf from sample first on */
+static int CheckLogBuf(const unsigned short *w, int first, int n){
+
+	int i;
+
+	for(i=0;i<n;i++){
+		if(XferToolFloat(w+2*i)!=LogBuf[first+i]) return 0;
+	}
+	return 1;
+}
+
+/** Commands wait in the queue for UpdateXfer, a full queue drops */
+static void CheckXferQueue(void){
+
+	unsigned short start[4] = { (XFER_START<<8) | XFER_R_LOGBUF, 0, 0, 30 };
+	unsigned short stop[4] = { XFER_STOP<<8, 0, 0, 0 };
+	int lost;
+	int i;
+
+	SimInit();
+	UpdateXfer();
+	XferReceive(start);
+	CHECK(XferFrames==0);
+	UpdateXfer();
+	CHECK(XferFrames==10);
+	XferReceive(stop);
+	CHECK(XferFrames==10);
+	UpdateXfer();
+	CHECK(XferFrames==0);
+
+	lost = XferQLost;
+	for(i=0;i<XFER_QSIZE;i++) XferReceive(stop);
+	CHECK(XferQLost==lost+1);
+	UpdateXfer();
+	XferReceive(start);
+	UpdateXfer();
+	CHECK(XferFrames==10);
+	XferReceive(stop);
+	UpdateXfer();
+}
+
+/** Capture SimRamp and stop, so LogBuf holds still while it is read */
+static void CheckCapture(void){
+
+	int n;
+
+	SimInit();
+	LogAddr0 = (LogAddr_t)&SimRamp;
+	LogChan = 1;
+	LogSkip = 0;
+	LogAuto = 0;
+	LogInit = 1;
+	SimRun(1);
+	LogTrigger = 1;
+	SimRun(LOG_SIZE+77);
+	LogTrigger = 0;
+	for(n=0;n<20;n++){
+		SimRun(7);
+		LogEvent(E_SETPOINT,n-10,0.5*n);
+	}
+	SimRun(SIM_BG_EVERY);
+}
+
+/** Byte offset of a variable from LogAddr0, as channel addresses travel */
+static long CheckOffset(const void *p){
+
+	return (long)((const char *)p - (const char *)&LogAddr0);
+}
+
+/** The int and long regions in target widths, 1 and 2 words */
+static void CheckXferWidths(void){
+
+	static unsigned short w[LOG_STATS_WORDS+2*EVENT_SIZE+EVENT_VAR_SIZE];
+	const unsigned short *h;
+	int ok;
+	int i;
+
+	CHECK(XferToolRead(XFER_R_TIME1,0L,2L*EVENT_SIZE,w)==2L*EVENT_SIZE);
+	CHECK(XferToolRead(XFER_R_TIME2,0L,2L*EVENT_SIZE,w+2*EVENT_SIZE)==2L*EVENT_SIZE);
+	ok = 1;
+	for(i=0;i<EVENT_SIZE;i++){
+		if(XferToolSigned(w+2*i)!=EventTime1[i]) ok = 0;
+		if(XferToolSigned(w+2*(EVENT_SIZE+i))!=EventTime2[i]) ok = 0;
+	}
+	CHECK(ok);
+
+	LogEvent(E_SETPOINT,-5,0.0);
+	CHECK(XferToolRead(XFER_R_CODE,0L,EVENT_SIZE,w)==EVENT_SIZE);
+	CHECK(XferToolRead(XFER_R_DATA1,0L,EVENT_SIZE,w+EVENT_SIZE)==EVENT_SIZE);
+	CHECK(XferToolRead(XFER_R_CRC,0L,EVENT_SIZE,w+2*EVENT_SIZE)==EVENT_SIZE);
+	ok = 1;
+	for(i=0;i<EVENT_SIZE;i++){
+		if((short)w[i]!=EventCode[i] || (short)w[EVENT_SIZE+i]!=EventData1[i]) ok = 0;
+		if(w[2*EVENT_SIZE+i]!=(unsigned short)EventCrc[i]) ok = 0;
+	}
+	CHECK(ok);
+	for(ok=0,i=0;i<EVENT_SIZE;i++){
+		if(w[i]==E_SETPOINT && (short)w[EVENT_SIZE+i]<0) ok = 1;
+	}
+	CHECK(ok);
+
+	CHECK(XferToolRead(XFER_R_VAR,0L,EVENT_VAR_SIZE,w)==EVENT_VAR_SIZE);
+	ok = 1;
+	for(i=0;i<EVENT_VAR_SIZE;i++){
+		if(w[i]!=(unsigned short)EventVar[i]) ok = 0;
+	}
+	CHECK(ok);
+
+	CHECK(XferToolRead(XFER_R_STATS,0L,LOG_STATS_WORDS,w)==LOG_STATS_WORDS);
+	ok = 1;
+	for(i=0;i<EVENT_CODES;i++){
+		if(XferToolLong(w+2*i)!=LogStats.EventCount[i]) ok = 0;
+	}
+	for(i=0;i<FAULT_COUNT;i++){
+		if(XferToolLong(w+2*(EVENT_CODES+i))!=LogStats.FaultCount[i]) ok = 0;
+	}
+#if(EVENT_HIST)
+	h = w + 2*(EVENT_CODES+FAULT_COUNT);
+	for(i=0;i<EVENT_CODES*EVENT_HIST_BINS;i++){
+		if(h[i]!=LogStats.EventHist[i/EVENT_HIST_BINS][i%EVENT_HIST_BINS]) ok = 0;
+	}
+#else
+	h = w;
+#endif
+	CHECK(ok);
+	CHECK(LogStats.EventCount[E_SETPOINT]>=20UL && h!=0);
+}
+
+/** Whole regions, the index, lost frames, an offset and the settings */
+static void CheckXferLoop(const char *link){
+
+	static unsigned short w[4*EVENT_SIZE];
+	XferToolIndex x;
+	unsigned long total;
+	long v;
+	int ok;
+	int i;
+
+	XferToolIdle = CheckIdle;
+	XferToolDrop = 0;
+	CHECK(XferToolRead(XFER_R_LOGBUF,0L,2L*LOG_SIZE,CheckWords)==2L*LOG_SIZE);
+	CHECK(CheckLogBuf(CheckWords,0,LOG_SIZE));
+	CHECK(XferResends==0);
+
+	CHECK(XferToolRead(XFER_R_DATA2,0L,2L*EVENT_SIZE,w)==2L*EVENT_SIZE);
+	ok = 1;
+	for(i=0;i<EVENT_SIZE;i++){
+		if(XferToolFloat(w+2*i)!=EventData2[i]) ok = 0;
+	}
+	CHECK(ok);
+	CHECK(XferToolRead(XFER_R_TICKS,0L,4L*EVENT_SIZE,w)==4L*EVENT_SIZE);
+	ok = 1;
+	for(i=0;i<EVENT_SIZE;i++){
+		if(XferToolTick(w+4*i)!=EventTicks[i]) ok = 0;
+	}
+	CHECK(ok);
+
+	// The index is one snapshot, the events may move on after it
+	total = EventTotal;
+	CHECK(XferToolReadIndex(&x)==0);
+	CHECK(x.EventTotal>=total && x.EventTotal<=EventTotal);
+	CHECK(x.EventIndex==(int)(x.EventTotal%EVENT_SIZE));
+	CHECK(x.EventVarSize==EVENT_VAR_SIZE);
+	CHECK(x.EventVarHead==EventVarHead && x.EventVarTail==EventVarTail);
+	CHECK(x.LogLength==LogLength && x.LogCount==LogCount);
+	CHECK(x.LogHdrSamples==LogHdrSamples && x.LogHdrStart==LogHdrStart);
+	CHECK(x.LogHdrPeriod==LogHdrPeriod && x.LogHdrTrigger==LogHdrTrigger);
+	CHECK(x.LogHdrTrigTick==LogHdrTrigTick);
+	CHECK(x.LogHdrType[0]==LogHdrType[0]);
+	CHECK(x.LogHdrAddr[0]==CheckOffset(&SimRamp));
+	CHECK(x.LogHdrAddr[1]==0L);
+	ok = (x.LogMarkIndex==LogMarkIndex);
+	for(i=0;i<LOG_MARKS;i++){
+		if(x.LogMarkSample[i]!=LogMarkSample[i] || x.LogMarkTick[i]!=LogMarkTick[i]) ok = 0;
+		if(x.LogMarkPeriod[i]!=LogMarkPeriod[i]) ok = 0;
+	}
+	CHECK(ok);
+
+	// Every 5th frame lost, the target goes back and the read completes
+	XferToolDrop = 5;
+	memset(CheckWords,0,sizeof(CheckWords));
+	CHECK(XferToolRead(XFER_R_LOGBUF,0L,2L*LOG_SIZE,CheckWords)==2L*LOG_SIZE);
+	CHECK(CheckLogBuf(CheckWords,0,LOG_SIZE));
+	CHECK(XferResends>0);
+	XferToolDrop = 0;
+
+	// From an offset
+	memset(CheckWords,0,sizeof(CheckWords));
+	CHECK(XferToolRead(XFER_R_LOGBUF,2L*1001,2L*500,CheckWords)==2L*500);
+	CHECK(CheckLogBuf(CheckWords,1001,500));
+
+	// Settings, a negative value and a write read back, the ISR counts a
+	// negative LogTrigger up once a sample while the reply comes back
+	CHECK(XferToolSet(XFER_V_TRIGGER,-30000L)==0);
+	CHECK(XferToolGet(XFER_V_TRIGGER,&v)==0 && v<0L && v>=-30000L);
+	CHECK(XferToolSet(XFER_V_TRIGGER,0L)==0);
+	CHECK(XferToolSet(XFER_V_SKIP,3L)==0);
+	CHECK(XferToolGet(XFER_V_SKIP,&v)==0 && v==3L);
+	CHECK(XferToolSet(XFER_V_Q15,5L)==0);
+	CHECK(XferToolGet(XFER_V_Q15,&v)==0 && v==5L && LogQ15==5);
+	CHECK(XferToolSet(XFER_V_Q15,0L)==0);
+	CHECK(LogSkip==3);
+
+	// Out of range values are refused and leave the setting as it was
+	CHECK(XferToolSet(XFER_V_CHAN,0L)==1);
+	CHECK(XferToolSet(XFER_V_CHAN,LOG_CHAN+1L)==1);
+	CHECK(XferToolSet(XFER_V_SKIP,-1L)==1);
+	CHECK(XferToolSet(XFER_V_SINGLE,2L)==1);
+	CHECK(XferToolSet(XFER_V_TRIGGER,40000L)==1);
+	CHECK(XferToolSet(XFER_V_Q15,1L<<LOG_CHAN)==1);
+	CHECK(LogChan==1 && LogSkip==3 && LogSingle==0 && LogTrigger==0 && LogQ15==0);
+	CHECK(XferToolGet(XFER_V_CHAN,&v)==0 && v==1L);
+
+	// A new LogChan starts a capture of that many channels
+	CHECK(XferToolSet(XFER_V_CHAN,3L)==0);
+	CHECK(XferToolGet(XFER_V_CHAN,&v)==0 && v==3L);
+	CHECK(LogChan==3 && LogLength==LOG_SIZE/3 && LogInit==0);
+	CHECK(XferToolSet(XFER_V_CHAN,1L)==0);
+	CHECK(XferToolGet(XFER_V_CHAN,&v)==0 && v==1L);
+	CHECK(LogChan==1 && LogLength==LOG_SIZE);
+
+	// Channel addresses by offset, either side of LogAddr0
+	CHECK(XferToolSet(XFER_V_ADDR0+1,CheckOffset(&SimBus))==0);
+	CHECK(XferToolGet(XFER_V_ADDR0+1,&v)==0 && v==CheckOffset(&SimBus));
+	CHECK(LogAddr1==(LogAddr_t)&SimBus);
+	CHECK(XferToolSet(XFER_V_ADDR0+2,CheckOffset(&WeRef))==0);
+	CHECK(XferToolGet(XFER_V_ADDR0+2,&v)==0 && v==CheckOffset(&WeRef));
+	CHECK(LogAddr2==(LogAddr_t)&WeRef);
+	CHECK(XferToolSet(XFER_V_ADDR0+2,0L)==0);
+	CHECK(XferToolGet(XFER_V_ADDR0+2,&v)==0 && v==0L);
+	CHECK(LogAddr2==0);
+
+	CheckXferWidths();
+	printf("xfer %s, %lu frames, %lu dropped on purpose\n", link, XferToolFrames, XferToolDropped);
+}
+
+/** Lowest free file descriptor */
+static int CheckFreeFd(void){
+
+	int fd;
+
+	fd = dup(0);
+	if(fd>=0) close(fd);
+	return fd;
+}
+
+/** A link that does not open leaves no socket behind on either side */
+static void CheckXferOpen(void){
+
+	int fd;
+
+	fd = CheckFreeFd();
+	CHECK(XferHostOpen("unix:/nonexistent/xfer.sock")!=0);
+	CHECK(XferToolOpen("unix:/nonexistent/xfer.sock")!=0);
+	CHECK(XferHostOpen("nocan9")!=0);
+	CHECK(XferToolOpen("nocan9")!=0);
+	CHECK(CheckFreeFd()==fd);
+}
+
+/** Loopback over the Unix socket, and over vcan0 when it exists */
+void CheckXfer(void){
+
+	CheckXferQueue();
+	CheckXferOpen();
+
+	CheckCapture();
+	CHECK(XferHostOpen(CHECK_LINK)==0);
+	CHECK(XferToolOpen(CHECK_LINK)==0);
+	CheckXferLoop(CHECK_LINK);
+	XferToolClose();
+	XferHostClose();
+
+	CheckCapture();
+	if(XferHostOpen("vcan0")==0 && XferToolOpen("vcan0")==0){
+		CheckXferLoop("vcan0");
+	}else{
+		printf("xfer vcan0, no interface, skipped\n");
+	}
+	XferToolClose();
+	XferHostClose();
+	XferToolIdle = 0;
+}
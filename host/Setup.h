@@ -0,0 +1,63 @@
+/**
+ * @file Setup.h
+ * @brief Host simulation stand-in for the application Setup.h.
+ *
+ * Supplies what Logs.c, Faults.c, Journal.c, LogXfer.c and SVM.c take from
+ * the drive application: buffer sizes, the state machine codes, the motor
+ * signals and the board hooks.  The definitions are in Sim.c, which runs the
+ * main ISR and the background loop in place of the drive.
+ */
+
+#ifndef SETUP_H_
+#define SETUP_H_
+
+#include <math.h>
+
+// Buffer sizes, as in the drive build
+#define LOG_SIZE		2000	/**< Log, floats in LogBuf */
+#define LOG_CHAN		9		/**< Log, most channels in one capture */
+#define EVENT_SIZE		64		/**< Events, records in the event ring */
+#define FAULT_COUNT		48		/**< Faults, past 32 so the checks cross a bitset word */
+#define SVM_INSTANCES	2		/**< Svm, two inverters so the checks see the instances apart */
+
+#define RECIP_SQRT3		0.57735027	/**< 1/sqrt(3) */
+
+// Main state machine
+#define INIT			0		/**< State, power up */
+#define READY			1		/**< State, PWM off, waiting for start */
+#define RUN				2		/**< State, PWM on */
+#define FAULT			3		/**< State, PWM off after a fault */
+
+#define FLAG2ON			(SimFlag2 = 1)	/**< Fault reset indicator on */
+
+extern int mainState;
+extern float WeRef;
+extern int FaultResetCount;
+extern int SimFlag2;
+
+// Motor signals
+extern float IdRef, IqRef, RpmRef;
+extern float Id, Iq, RpmOut;
+extern float VdRef, VqRef, ThetaOut;
+extern float Ia, Ib, Ic;
+
+// Modulator globals of the UpdateSpaceVector wrapper
+extern float SvmAlpha, SvmBeta, SvmBetaSqrt3, SvmAlphaAbs;
+extern float SvmTx, SvmTy, SvmT0, SvmT02, SvmK;
+extern float SvmOnA, SvmOnB, SvmOnC, SvmDtc;
+extern int SvmSector, SvmClip, SvmMethod, SvmPeriod;
+
+// Board hooks
+void PWM_disable(void);
+void TimeStamp(long *part1, long *part2);
+
+// Logging entry points without a prototype in Logs.h
+void InitLog(void);
+void UpdateLog(void);
+void DefaultLog(int i);
+void InitEvents(void);
+void LogEvent(int Code, int Data1, float Data2);
+
+#include "Logs.h"
+
+#endif /* SETUP_H_ */
@@ -0,0 +1,335 @@
+/**
+ * @file Sim.c
+ * @brief Host simulation of the main ISR and the background loop.
+ *
+ * Runs the drive's ISR sequence on a PC from a loop, faster than real time:
+ * synthetic motor signals, UpdateFaults, UpdateSpaceVector and UpdateLog in
+ * every pass, and CommitEvents, SyncEvents, UpdateWarm, UpdateJournal and
+ * the CAN transfer every SIM_BG_EVERY passes.  TimeStamp is virtual, part 2
+ * counts ISR passes and carries into part 1 at TIME2_WRAP, so a run is
+ * deterministic and the same on every host.
+ *
+ * Each pass starts at the period boundary by committing the compare set
+ * staged in the pass before with CommitPwm into SimCmpA to SimCmpC, the
+ * compare registers of the simulated bridge.
+ *
+ * With SimLoad set the modulator drives a three-phase RL load instead:
+ * an open loop reference of SimVref at SimSpeed, a bridge that switches
+ * the committed compares and loses SimDead counts of each in the
+ * direction of the phase current, and the measured currents Ia, Ib, Ic
+ * carry SimINoise.  The reference
+ * current SvmIAlpha, SvmIBeta is the steady state of the load.
+ *
+ * Faults are injected with SimInject, which calls Fault() from the ISR, or
+ * with SimOverride, which holds a signal watched by a fault limit.
+ * SimInit starts a fresh board, SimPowerCycle boots it again with only
+ * the journal kept and SimSoftReset restarts it with the RAM kept.
+ */
+
+#include <string.h>
+#include "Setup.h"
+#include "SVM.h"
+#include "Sim.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+// Application state and signals named by Setup.h
+int mainState = READY;		/**< State machine, INIT, READY, RUN or FAULT */
+float WeRef = 0;			/**< Speed reference, electrical rad/s */
+int FaultResetCount = 0;	/**< ISR passes left with the fault reset line on */
+int SimFlag2 = 0;			/**< Fault reset line, set by FLAG2ON */
+float IdRef = 0, IqRef = 0, RpmRef = 0;
+float Id = 0, Iq = 0, RpmOut = 0;
+float VdRef = 0, VqRef = 0, ThetaOut = 0;
+float Ia = 0, Ib = 0, Ic = 0;
+float SvmAlpha, SvmBeta, SvmBetaSqrt3, SvmAlphaAbs;
+float SvmTx, SvmTy, SvmT0, SvmT02, SvmK;
+float SvmOnA, SvmOnB, SvmOnC, SvmDtc;
+int SvmSector, SvmClip, SvmMethod = SVM_SYMMETRIC, SvmPeriod = 3750;
+
+long SimRate = SIM_RATE;		/**< Sim, ISR passes per second */
+unsigned long long SimTick = 0;	/**< Sim, ISR passes since SimInit */
+float SimSpeed = 50.0;			/**< Sim, electrical frequency of the speed reference, Hz */
+float SimBus = 0;				/**< Sim, DC bus voltage */
+float SimTemp = 0;				/**< Sim, heatsink temperature */
+float SimSpeedErr = 0;			/**< Sim, speed error RpmRef-RpmOut, rpm */
+float SimRamp = 0;				/**< Sim, SimTick modulo 2^24, a signal whose log is easy to check */
+int SimPwmOn = 0;				/**< Sim, 1 while the bridge switches, PWM_disable clears it */
+long SimPwmOff = 0;				/**< Sim, PWM_disable calls */
+int SimLoad = 0;				/**< Sim, 1 to drive an RL load from the on-times */
+float SimVref = 0.05;			/**< Sim load, |Vref| of the open loop reference at SimSpeed */
+float SimDead = 0;				/**< Sim load, on-time lost in the direction of the current, counts */
+float SimINoise = 0;			/**< Sim load, peak to peak noise on the measured currents */
+float SimIa = 0, SimIb = 0, SimIc = 0;	/**< Sim load, phase currents before the noise */
+volatile unsigned int SimCmpA = 0, SimCmpB = 0, SimCmpC = 0;	/**< Sim, compare registers of the bridge, written by CommitPwm */
+int SimFaultCount = 0;			/**< Sim, entries in SimFaults */
+SimFault SimFaults[SIM_FAULTS];	/**< Sim, fault injection table */
+
+static unsigned long SimNoise = 1;	// state of the noise generator
+static float SimTheta = 0;			// angle of the load reference
+
+// Logs.c state that a reset clears
+extern volatile unsigned long long LogTicks;
+extern unsigned int WarmMagic;
+extern unsigned int WarmLogMagic;
+extern int LogHold;
+extern int LogTrigger;
+extern int OldTrigger;
+extern int FaultLimitCount;
+
+/** Board hook, stop switching */
+void PWM_disable(void){
+
+	SimPwmOn = 0;
+	SimPwmOff++;
+}
+
+/** Board hook, virtual wall clock derived from SimTick */
+void TimeStamp(long *part1, long *part2){
+
+	*part1 = (long)(SimTick / TIME2_WRAP);
+	*part2 = (long)(SimTick % TIME2_WRAP) * TIME2_PER_TICK;
+}
+
+/** Uniform noise in -0.5 to 0.5, the same sequence on every host */
+static float SimRand(void){
+
+	SimNoise = SimNoise*1103515245UL + 12345UL;
+	return (float)((SimNoise>>16) & 0x7FFF) / 32768.0 - 0.5;
+}
+
+/** Start the firmware, warm keeps RAM as a soft reset does */
+static void SimBoot(int warm){
+
+	SimTick = 0;
+	SimNoise = 1;
+	SimPwmOn = 1;
+	SimPwmOff = 0;
+	SimFaultCount = 0;
+	mainState = READY;
+	WeRef = 2.0*M_PI*SimSpeed;
+	RpmRef = RpmOut = ThetaOut = 0;
+	IdRef = IqRef = Id = Iq = VdRef = VqRef = 0;
+	SimIa = SimIb = SimIc = SimTheta = 0;
+	memset(&SvmCmp,0,sizeof(SvmCmp));
+	SimCmpA = SimCmpB = SimCmpC = 0;
+	SimBus = 300.0;
+	SimTemp = 40.0;
+
+	// The startup code clears everything that is not NOINIT
+	LogTicks = 0;
+	LogTrigger = 0;
+	OldTrigger = 0;
+	FaultLimitCount = 0;
+	if(!warm){
+		WarmMagic = 0;
+		WarmLogMagic = 0;
+		LogHold = 0;
+	}
+	InitEvents();
+	ResetFaults();
+	if(!LogHold) DefaultLog(1);
+	InitLog();
+}
+
+/** Fresh board, cold boot with a blank journal */
+void SimInit(void){
+
+#if(EVENT_JOURNAL)
+	int i;
+
+	for(i=0;i<JOURNAL_SECTORS;i++) NvErase(i);
+#endif
+	SimBoot(0);
+}
+
+/** Cold boot that keeps the journal, as after a power failure */
+void SimPowerCycle(void){
+
+	SimBoot(0);
+}
+
+/** Restart the firmware with the RAM contents kept */
+void SimSoftReset(void){
+
+	SimBoot(1);
+}
+
+/** Call Fault(code,data) from the ISR for passes passes from tick,
+ *  returns the table index or -1 when full */
+int SimInject(unsigned long long tick, long passes, long code, float data){
+
+	SimFault *f;
+
+	if(SimFaultCount>=SIM_FAULTS) return -1;
+	f = &SimFaults[SimFaultCount];
+	f->Tick = tick;
+	f->Passes = passes;
+	f->Code = code;
+	f->Data = data;
+	f->Signal = 0;
+	f->Value = 0;
+	return SimFaultCount++;
+}
+
+/** Hold *signal at value for passes passes from tick */
+int SimOverride(unsigned long long tick, long passes, float *signal, float value){
+
+	int i = SimInject(tick, passes, -1L, 0);
+
+	if(i>=0){
+		SimFaults[i].Signal = signal;
+		SimFaults[i].Value = value;
+	}
+	return i;
+}
+
+/** Synthetic drive: the speed follows WeRef while PWM is on and coasts
+ *  when it is off, currents and voltages follow the speed with a little
+ *  noise, and the modulator gets the voltage vector at ThetaOut */
+void SimSignals(void){
+
+	float dt = 1.0 / SimRate;
+	float rpm = WeRef * (60.0/(2.0*M_PI)) / 2.0;	// two pole pairs
+	float we;
+	float c;
+	float s;
+
+	RpmRef = rpm;
+	if(SimPwmOn){
+		RpmOut += (RpmRef - RpmOut) * dt / 0.05;
+		IqRef = 0.5 + 0.01*(RpmRef - RpmOut);
+		IdRef = 0;
+		Iq = IqRef + 0.02*SimRand();
+		Id = IdRef + 0.02*SimRand();
+	}else{
+		RpmOut -= RpmOut * dt / 2.0;
+		IqRef = IdRef = Iq = Id = 0;
+	}
+	SimSpeedErr = RpmRef - RpmOut;
+	we = RpmOut * (2.0*M_PI/60.0) * 2.0;
+	ThetaOut += we * dt;
+	if(ThetaOut>M_PI) ThetaOut -= 2.0*M_PI;
+	VqRef = 0.6*RpmOut/1500.0 + 0.05*Iq;
+	VdRef = 0.05*Id - 0.0002*we*Iq;
+
+	c = cos(ThetaOut);
+	s = sin(ThetaOut);
+	SvmAlpha = VdRef*c - VqRef*s;
+	SvmBeta = VdRef*s + VqRef*c;
+	Ia = Id*c - Iq*s;
+	Ib = -0.5*Ia + 0.8660254*(Id*s + Iq*c);
+	Ic = -Ia - Ib;
+
+	SimBus = 300.0 + 2.0*sin(2.0*M_PI*100.0*(float)SimTick*dt) + SimRand();
+	SimTemp = 40.0 + 0.1*SimRand();
+	SimRamp = (float)(SimTick & 0xFFFFFFUL);
+}
+
+/** Deadtime error of one phase in counts, saturating at SIM_LOAD_SAT */
+static float SimDeadtime(float i){
+
+	i = i / SIM_LOAD_SAT;
+	if(i>1.0) i = 1.0;
+	if(i<-1.0) i = -1.0;
+	return SimDead * i;
+}
+
+/** RL load driven by the committed compares, the bus is 1 */
+static void SimLoadStep(float dt){
+
+	float va, vb, vc, vn;
+	float we = 2.0*M_PI*SimSpeed;
+	float z, phi;
+
+	va = ((float)SimCmpA - SimDeadtime(SimIa)) / SvmPeriod;
+	vb = ((float)SimCmpB - SimDeadtime(SimIb)) / SvmPeriod;
+	vc = ((float)SimCmpC - SimDeadtime(SimIc)) / SvmPeriod;
+	vn = (va + vb + vc) / 3.0;
+	SimIa += (va - vn - SIM_LOAD_R*SimIa) * dt / SIM_LOAD_L;
+	SimIb += (vb - vn - SIM_LOAD_R*SimIb) * dt / SIM_LOAD_L;
+	SimIc = -SimIa - SimIb;
+	Ia = SimIa + SimINoise*SimRand();
+	Ib = SimIb + SimINoise*SimRand();
+	Ic = SimIc + SimINoise*SimRand();
+
+	// The phase voltage of a unit active vector is 2/3 of the bus
+	SimTheta += we * dt;
+	if(SimTheta>M_PI) SimTheta -= 2.0*M_PI;
+	SvmAlpha = SimVref*cos(SimTheta);
+	SvmBeta = SimVref*sin(SimTheta);
+	z = (2.0/3.0) * SimVref / sqrt(SIM_LOAD_R*SIM_LOAD_R + we*we*SIM_LOAD_L*SIM_LOAD_L);
+	phi = atan2(we*SIM_LOAD_L, SIM_LOAD_R);
+	SvmIAlpha = z*cos(SimTheta - phi);
+	SvmIBeta = z*sin(SimTheta - phi);
+}
+
+/** One pass of the main ISR */
+void SimIsr(void){
+
+	SimFault *f;
+	int i;
+
+	SimTick++;
+	CommitPwm(&SvmCmp, &SimCmpA, &SimCmpB, &SimCmpC);
+	SimSignals();
+	if(SimLoad) SimLoadStep(1.0 / SimRate);
+
+	// Overrides first so the fault limits see them in this pass
+	for(i=0,f=SimFaults;i<SimFaultCount;i++,f++){
+		if(SimTick>=f->Tick && SimTick<f->Tick+(unsigned long long)f->Passes && f->Signal!=0){
+			*(f->Signal) = f->Value;
+		}
+	}
+	UpdateFaults();
+	for(i=0,f=SimFaults;i<SimFaultCount;i++,f++){
+		if(SimTick>=f->Tick && SimTick<f->Tick+(unsigned long long)f->Passes && f->Code>=0L){
+			Fault(f->Code,f->Data);
+		}
+	}
+
+	if(SimPwmOn) UpdateSpaceVector();
+	UpdateLog();
+	if(FaultResetCount>0 && --FaultResetCount==0) SimFlag2 = 0;
+}
+
+/** One pass of the background loop */
+void SimBackground(void){
+
+	CommitEvents();
+	SyncEvents();
+	UpdateWarm();
+#if(EVENT_JOURNAL)
+	UpdateJournal();
+#endif
+	XferHostPoll();
+}
+
+/** Run passes ISR passes with the background loop in between */
+void SimRun(long passes){
+
+	long i;
+
+	for(i=0;i<passes;i++){
+		SimIsr();
+		if((SimTick % SIM_BG_EVERY)==0) SimBackground();
+	}
+}
+
+/** Free running cycle counter for the benchmarks, nanoseconds where the
+ *  processor has no counter readable from user code */
+unsigned long long SimCycles(void){
+
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return (unsigned long long)ts.tv_sec*1000000000ULL + ts.tv_nsec;
+#endif
+}
@@ -0,0 +1,69 @@
+/**
+ * @file Sim.h
+ * @brief Host simulation of the main ISR and the background loop.
+ */
+
+#ifndef SIM_H_
+#define SIM_H_
+
+#ifndef SIM_RATE
+#define SIM_RATE		10000L	/**< Sim, default ISR passes per second */
+#endif
+#ifndef SIM_BG_EVERY
+#define SIM_BG_EVERY	10		/**< Sim, ISR passes per background loop pass */
+#endif
+#ifndef SIM_LOAD_R
+#define SIM_LOAD_R		0.1		/**< Sim load, phase resistance, per unit of the bus */
+#endif
+#ifndef SIM_LOAD_L
+#define SIM_LOAD_L		0.0003	/**< Sim load, phase inductance, per unit of the bus, s */
+#endif
+#ifndef SIM_LOAD_SAT
+#define SIM_LOAD_SAT	0.05	/**< Sim load, current where the deadtime error saturates */
+#endif
+#ifndef SIM_FAULTS
+#define SIM_FAULTS		16		/**< Sim, size of the fault injection table */
+#endif
+
+// Fault injection, Fault(Code,Data) is called from the ISR in every pass
+// from Tick for Passes passes.  A signal override holds *Signal at Value
+// over the same window, for the limits of Faults.c.
+typedef struct {
+	unsigned long long Tick;	/**< Sim fault, first ISR pass */
+	long Passes;				/**< Sim fault, number of passes */
+	long Code;					/**< Sim fault, code passed to Fault, -1 for an override */
+	float Data;					/**< Sim fault, data2 passed to Fault */
+	float *Signal;				/**< Sim fault, signal to override or 0 */
+	float Value;				/**< Sim fault, value of the override */
+} SimFault;
+
+extern long SimRate;
+extern unsigned long long SimTick;
+extern float SimSpeed;
+extern float SimBus;
+extern float SimTemp;
+extern float SimSpeedErr;
+extern float SimRamp;
+extern int SimPwmOn;
+extern long SimPwmOff;
+extern int SimLoad;
+extern float SimVref;
+extern float SimDead;
+extern float SimINoise;
+extern float SimIa, SimIb, SimIc;
+extern volatile unsigned int SimCmpA, SimCmpB, SimCmpC;
+extern int SimFaultCount;
+extern SimFault SimFaults[SIM_FAULTS];
+
+void SimInit(void);
+void SimPowerCycle(void);
+void SimSoftReset(void);
+int SimInject(unsigned long long tick, long passes, long code, float data);
+int SimOverride(unsigned long long tick, long passes, float *signal, float value);
+void SimSignals(void);
+void SimIsr(void);
+void SimBackground(void);
+void SimRun(long passes);
+unsigned long long SimCycles(void);
+
+#endif /* SIM_H_ */
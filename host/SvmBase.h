@@ -0,0 +1,11 @@
+/**
+ * @file SvmBase.h
+ * @brief Reference modulator of the checks and benchmarks, see SvmBase.c.
+ */
+
+#ifndef SVMBASE_H_
+#define SVMBASE_H_
+
+void UpdateSpaceVectorBase(void);
+
+#endif /* SVMBASE_H_ */
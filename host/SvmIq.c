@@ -0,0 +1,75 @@
+/**
+ * @file SvmIq.c
+ * @brief Q15 build of the modulator beside the float one, for the checks.
+ *
+ * SVM.c is compiled a second time with SVM_IQ 1 and every external name
+ * renamed, so one program can run both builds on the same inputs.
+ */
+
+#undef SVM_IQ
+#define SVM_IQ	1
+
+#define SvmInst				SvmIqInst
+#define SvmCmp				SvmIqCmp
+#define SvmClampOn			SvmIqClampOn
+#define SvmClampOff			SvmIqClampOff
+#define SvmPsi				SvmIqPsi
+#define SvmOverMod			SvmIqOverMod
+#define SvmDtcMode			SvmIqDtcMode
+#define SvmDtcBand			SvmIqDtcBand
+#define SvmIAlpha			SvmIqIAlpha
+#define SvmIBeta			SvmIqIBeta
+#define SvmMinMode			SvmIqMinMode
+#define SvmMinPulse			SvmIqMinPulse
+#define SpaceVector			SvmIqSpaceVector
+#define SvmSetPsi			SvmIqSetPsi
+#define UpdateSpaceVector	SvmIqUpdateSpaceVector
+#define UpdateSpaceVectors	SvmIqUpdateSpaceVectors
+#define StagePwm			SvmIqStagePwm
+#define CommitPwm			SvmIqCommitPwm
+
+#include "SVM.c"
+#include "SvmIq.h"
+
+static SvmOutputs SvmIqState[SVM_IQ_CONTEXTS];	// outputs read back by the next pass
+
+/** Start a modulator context afresh */
+void SvmIqReset(int ctx){
+
+	SvmOutputs zero = {0};
+
+	SvmIqState[ctx] = zero;
+}
+
+/** One Q15 modulator pass on float inputs */
+void SvmIqRun(int ctx, const SvmIqIn *in, SvmIqOut *out){
+
+	SvmInputs q;
+	SvmOutputs *s = &SvmIqState[ctx];
+
+	q.Alpha = SVM_FROMF(in->Alpha);
+	q.Beta = SVM_FROMF(in->Beta);
+	q.Period = in->Period;
+	q.Method = in->Method;
+	q.ClampOn = SVM_FROMF(in->ClampOn);
+	q.ClampOff = SVM_FROMF(in->ClampOff);
+	SvmSetPsi(&q, in->Psi);
+	q.OverMod = in->OverMod;
+	q.DtcMode = in->DtcMode;
+	q.Dtc = SVM_FROMF(in->Dtc);
+	q.DtcBand = SVM_FROMF(in->DtcBand);
+	q.Ia = SVM_FROMF(in->Ia);
+	q.Ib = SVM_FROMF(in->Ib);
+	q.Ic = SVM_FROMF(in->Ic);
+	q.IAlpha = SVM_FROMF(in->IAlpha);
+	q.IBeta = SVM_FROMF(in->IBeta);
+	q.MinMode = in->MinMode;
+	q.MinPulse = SVM_FROMF(in->MinPulse);
+	SpaceVector(&q, s);
+	out->OnA = SVM_TOF(s->OnA);
+	out->OnB = SVM_TOF(s->OnB);
+	out->OnC = SVM_TOF(s->OnC);
+	out->Sector = s->Sector;
+	out->Clip = s->Clip;
+	out->OverMode = s->OverMode;
+}
@@ -0,0 +1,45 @@
+/**
+ * @file SvmIq.h
+ * @brief Q15 build of the modulator beside the float one, for the checks.
+ */
+
+#ifndef SVMIQ_H_
+#define SVMIQ_H_
+
+#define SVM_IQ_CONTEXTS	4		/**< SvmIq, modulators kept side by side */
+
+// Float view of SvmInputs and SvmOutputs, converted to and from Q15
+typedef struct {
+	float Alpha;
+	float Beta;
+	int Period;
+	int Method;
+	float ClampOn;
+	float ClampOff;
+	float Psi;
+	int OverMod;
+	int DtcMode;
+	float Dtc;
+	float DtcBand;
+	float Ia;
+	float Ib;
+	float Ic;
+	float IAlpha;
+	float IBeta;
+	int MinMode;
+	float MinPulse;
+} SvmIqIn;
+
+typedef struct {
+	float OnA;
+	float OnB;
+	float OnC;
+	int Sector;
+	int Clip;
+	int OverMode;
+} SvmIqOut;
+
+void SvmIqReset(int ctx);
+void SvmIqRun(int ctx, const SvmIqIn *in, SvmIqOut *out);
+
+#endif /* SVMIQ_H_ */
@@ -0,0 +1,164 @@
+/**
+ * @file Xfer.c
+ * @brief Command line log readout over the CAN block transfer.
+ *
+ * Usage: xfer <link> <command> ...
+ *   index                          log positions and capture header
+ *   read <region> [offset [count]] words of a region, in hex
+ *   floats <region> [offset [count]] pairs of words as floats
+ *   get <setting>                  value of an XFER_V_* setting
+ *   set <setting> <value>          write an XFER_V_* setting, exits with 3
+ *                                  when the target refuses the value
+ *   reset                          ResetFaults on the target
+ *
+ * The link is a SocketCAN interface (can0, vcan0) or unix:<path> of a
+ * simulated target.  Regions and settings are given by number or by the
+ * name of their XFER_R_* and XFER_V_* define without the prefix, in any
+ * case.  Offset and count are in 16-bit words, count 0 reads to the end.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "Setup.h"
+#include "XferTool.h"
+
+static const char * const XferRegionNames[XFER_REGIONS] = {
+	"logbuf", "time1", "time2", "code", "data1", "data2", "ticks", "crc",
+	"var", "stats", "index"
+};
+
+static const char * const XferSettingNames[XFER_SETTINGS] = {
+	"trigger", "init", "chan", "skip", "single", "auto", "hold",
+	"addr0", "addr1", "addr2", "addr3", "addr4", "addr5", "addr6", "addr7", "addr8",
+	"q15"
+};
+
+/** Target words of each region */
+static unsigned long XferWords(int region){
+
+	switch(region){
+	case XFER_R_LOGBUF:	return 2UL*LOG_SIZE;
+	case XFER_R_TIME1:
+	case XFER_R_TIME2:
+	case XFER_R_DATA2:	return 2UL*EVENT_SIZE;
+	case XFER_R_CODE:
+	case XFER_R_DATA1:
+	case XFER_R_CRC:	return EVENT_SIZE;
+	case XFER_R_TICKS:	return 4UL*EVENT_SIZE;
+	case XFER_R_VAR:	return EVENT_VAR_SIZE;
+	case XFER_R_STATS:	return LOG_STATS_WORDS;
+	case XFER_R_INDEX:	return XFER_INDEX_WORDS;
+	default:			return 0;
+	}
+}
+
+/** Number or name in a table, -1 when neither */
+static int XferLookup(const char *s, const char * const *names, int n){
+
+	char *end;
+	long v;
+	int i;
+
+	v = strtol(s,&end,0);
+	if(*end=='\0' && v>=0 && v<n) return (int)v;
+	for(i=0;i<n;i++){
+		if(strcasecmp(s,names[i])==0) return i;
+	}
+	return -1;
+}
+
+/** Print the index */
+static int XferPrintIndex(void){
+
+	XferToolIndex x;
+	int i;
+
+	if(XferToolReadIndex(&x)!=0) return 1;
+	printf("EventIndex %d\nEventTotal %lu\n", x.EventIndex, x.EventTotal);
+	printf("EventVarHead %d\nEventVarTail %d\nEventVarSize %d\n", x.EventVarHead, x.EventVarTail, x.EventVarSize);
+	printf("LogLength %d\nLogCount %d\n", x.LogLength, x.LogCount);
+	printf("LogHdrStart %llu\nLogHdrSamples %lu\n", x.LogHdrStart, x.LogHdrSamples);
+	printf("LogHdrPeriod %d\nLogHdrTrigger %d\nLogHdrTrigTick %llu\n", x.LogHdrPeriod, x.LogHdrTrigger, x.LogHdrTrigTick);
+	for(i=0;i<LOG_CHAN;i++){
+		printf("LogHdrAddr[%d] %ld type %d\n", i, x.LogHdrAddr[i], x.LogHdrType[i]);
+	}
+	printf("LogMarkIndex %d\n", x.LogMarkIndex);
+	for(i=0;i<LOG_MARKS;i++){
+		printf("LogMark[%d] sample %lu tick %llu period %d\n", i, x.LogMarkSample[i], x.LogMarkTick[i], x.LogMarkPeriod[i]);
+	}
+	return 0;
+}
+
+/** Read and print part of a region */
+static int XferPrintRegion(int region, int argc, char **argv, int floats){
+
+	unsigned short *w;
+	unsigned long words = XferWords(region);
+	unsigned long offset = (argc>0) ? strtoul(argv[0],0,0) : 0UL;
+	unsigned long count = (argc>1) ? strtoul(argv[1],0,0) : 0UL;
+	long n;
+	long i;
+
+	if(offset>=words) return 1;
+	if(count==0 || offset+count>words) count = words - offset;
+	w = malloc(count*sizeof(w[0]));
+	if(w==0) return 1;
+	n = XferToolRead(region,offset,count,w);
+	for(i=0;i<n;i++){
+		if(floats){
+			if((i&1)==0 && i+1<n) printf("%lu %g\n", offset+i, XferToolFloat(w+i));
+		}else{
+			printf("%s%04x", (i%8)==0 ? (i ? "\n" : "") : " ", w[i]);
+		}
+	}
+	if(!floats && n>0) printf("\n");
+	free(w);
+	return (n==(long)count) ? 0 : 1;
+}
+
+int main(int argc, char **argv){
+
+	long value;
+	int k;
+	int rc = 2;
+
+	if(argc<3){
+		fprintf(stderr,"usage: xfer <link> index|read|floats|get|set|reset ...\n");
+		return 2;
+	}
+	if(XferToolOpen(argv[1])!=0){
+		fprintf(stderr,"xfer: cannot open %s\n", argv[1]);
+		return 1;
+	}
+
+	if(strcmp(argv[2],"index")==0){
+		rc = XferPrintIndex();
+	}else if((strcmp(argv[2],"read")==0 || strcmp(argv[2],"floats")==0) && argc>3){
+		k = XferLookup(argv[3],XferRegionNames,XFER_REGIONS);
+		if(k>=0) rc = XferPrintRegion(k,argc-4,argv+4,argv[2][0]=='f');
+	}else if(strcmp(argv[2],"get")==0 && argc>3){
+		k = XferLookup(argv[3],XferSettingNames,XFER_SETTINGS);
+		if(k>=0 && XferToolGet(k,&value)==0){
+			printf("%ld\n", value);
+			rc = 0;
+		}else if(k>=0){
+			rc = 1;
+		}
+	}else if(strcmp(argv[2],"set")==0 && argc>4){
+		k = XferLookup(argv[3],XferSettingNames,XFER_SETTINGS);
+		if(k>=0){
+			rc = XferToolSet(k,strtol(argv[4],0,0));
+			if(rc<0) rc = 1;
+			else if(rc==1) rc = 3;
+		}
+	}else if(strcmp(argv[2],"reset")==0){
+		rc = XferToolReset()!=0;
+	}
+	if(rc==2) fprintf(stderr,"xfer: bad command\n");
+	else if(rc==3) fprintf(stderr,"xfer: %s out of range\n", argv[4]);
+	else if(rc) fprintf(stderr,"xfer: no answer from %s\n", argv[1]);
+	XferToolClose();
+	return rc;
+}
@@ -0,0 +1,71 @@
+/**
+ * @file XferSim.c
+ * @brief Simulated drive serving the CAN log transfer, in place of a board.
+ *
+ * Usage: xfersim <link> [speed]
+ *
+ * Runs the simulation of Sim.c with the real Logs.c, Faults.c and
+ * LogXfer.c and serves the link with XferHostOpen, a SocketCAN interface
+ * (vcan0) or unix:<path>.  speed is the multiple of real time the ISR runs
+ * at, 1 by default, 0 runs as fast as the host allows.  The drive starts
+ * with DefaultLog(1) armed, a tool reads it and sets it up with the xfer
+ * commands as it would a board.  SIGINT or SIGTERM stops it.
+ */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "Setup.h"
+#include "Sim.h"
+
+static volatile sig_atomic_t XferSimStop = 0;	// set by the signal handler
+
+static void XferSimSignal(int sig){
+
+	(void)sig;
+	XferSimStop = 1;
+}
+
+/** Seconds of the monotonic clock */
+static double XferSimNow(void){
+
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+int main(int argc, char **argv){
+
+	struct timespec nap = { 0, 200000L };
+	double speed = (argc>2) ? atof(argv[2]) : 1.0;
+	double start;
+	double due;
+
+	if(argc<2){
+		fprintf(stderr,"usage: xfersim <link> [speed]\n");
+		return 2;
+	}
+	signal(SIGINT,XferSimSignal);
+	signal(SIGTERM,XferSimSignal);
+
+	SimInit();
+	if(XferHostOpen(argv[1])!=0){
+		fprintf(stderr,"xfersim: cannot open %s\n", argv[1]);
+		return 1;
+	}
+	fprintf(stderr,"xfersim: serving %s at %g x real time\n", argv[1], speed);
+
+	// One background pass at a time, paced to the ISR rate times speed
+	start = XferSimNow();
+	while(!XferSimStop){
+		SimRun(SIM_BG_EVERY);
+		if(speed>0){
+			due = start + (double)SimTick / (SimRate*speed);
+			while(!XferSimStop && XferSimNow()<due) nanosleep(&nap,0);
+		}
+	}
+	XferHostClose();
+	return 0;
+}
@@ -0,0 +1,350 @@
+/**
+ * @file XferTool.c
+ * @brief Host receiver of the windowed CAN block transfer, see LogXfer.c.
+ *
+ * Reads a region with XFER_START and acknowledges every XferToolAckEvery
+ * frames.  Frames that arrive out of order are dropped, the target goes
+ * back to the acknowledged point after its XferTimeout.  When nothing
+ * arrives for XferToolTimeout waits the read resumes with a new XFER_START
+ * at the first missing word, up to XFER_TOOL_RESTARTS times.
+ *
+ * The link is a SocketCAN interface such as vcan0 or can0, or
+ * "unix:<path>" for the Unix datagram socket a HOST_SIM build binds with
+ * XferHostOpen.  A wait is one call of XferToolIdle when it is set, which
+ * lets a check run the target in the same process, or 1 ms otherwise.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <poll.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+#include "Setup.h"
+#include "XferTool.h"
+
+#define XFER_TOOL_CHUNK		61440UL	/**< Xfer tool, words per XFER_START, within the 16-bit count and sequence */
+#define XFER_TOOL_RESTARTS	5		/**< Xfer tool, resumes of a stalled read before giving up */
+#define XFER_TOOL_QUIET		3		/**< Xfer tool, empty waits that end the drain before a start */
+
+void (*XferToolIdle)(void) = 0;		/**< Xfer tool, run while waiting, 0 to sleep */
+long XferToolTimeout = 1000L;		/**< Xfer tool, waits without a frame before a read resumes */
+int XferToolAckEvery = 8;			/**< Xfer tool, frames per acknowledgement */
+int XferToolDrop = 0;				/**< Xfer tool, drop every Nth data frame to test recovery, 0 for none */
+unsigned long XferToolFrames = 0;	/**< Xfer tool, in order data frames received */
+unsigned long XferToolDropped = 0;	/**< Xfer tool, frames dropped by XferToolDrop */
+int XferToolRestarts = 0;			/**< Xfer tool, resumes in the last read */
+
+static unsigned long XferToolSeen = 0;		// data frames counted for XferToolDrop
+static int XferToolSock = -1;				// socket carrying the frames
+static int XferToolUnix = 0;				// 1 for a Unix socket, 0 for SocketCAN
+static struct sockaddr_un XferToolPeer;		// target address for the Unix socket
+static struct sockaddr_un XferToolSelf;		// own address for the Unix socket
+
+/** Open the link to the target, returns 0 when open */
+int XferToolOpen(const char *name){
+
+	struct sockaddr_can can;
+	struct can_filter filter;
+	struct ifreq ifr;
+
+	XferToolClose();
+	if(strncmp(name,"unix:",5)==0){
+		XferToolUnix = 1;
+		XferToolSock = socket(AF_UNIX,SOCK_DGRAM,0);
+		if(XferToolSock<0) return -1;
+		memset(&XferToolPeer,0,sizeof(XferToolPeer));
+		XferToolPeer.sun_family = AF_UNIX;
+		strncpy(XferToolPeer.sun_path,name+5,sizeof(XferToolPeer.sun_path)-1);
+		memset(&XferToolSelf,0,sizeof(XferToolSelf));
+		XferToolSelf.sun_family = AF_UNIX;
+		snprintf(XferToolSelf.sun_path,sizeof(XferToolSelf.sun_path),"%s.%d",name+5,(int)getpid());
+		unlink(XferToolSelf.sun_path);
+		if(bind(XferToolSock,(struct sockaddr *)&XferToolSelf,sizeof(XferToolSelf))==0) return 0;
+		XferToolClose();
+		return -1;
+	}
+
+	XferToolUnix = 0;
+	XferToolSock = socket(PF_CAN,SOCK_RAW,CAN_RAW);
+	if(XferToolSock<0) return -1;
+	filter.can_id = XFER_TX_ID;
+	filter.can_mask = CAN_SFF_MASK;
+	setsockopt(XferToolSock,SOL_CAN_RAW,CAN_RAW_FILTER,&filter,sizeof(filter));
+	memset(&ifr,0,sizeof(ifr));
+	strncpy(ifr.ifr_name,name,IFNAMSIZ-1);
+	if(ioctl(XferToolSock,SIOCGIFINDEX,&ifr)<0){
+		XferToolClose();
+		return -1;
+	}
+	memset(&can,0,sizeof(can));
+	can.can_family = AF_CAN;
+	can.can_ifindex = ifr.ifr_ifindex;
+	if(bind(XferToolSock,(struct sockaddr *)&can,sizeof(can))==0) return 0;
+	XferToolClose();
+	return -1;
+}
+
+/** Close the link */
+void XferToolClose(void){
+
+	if(XferToolSock<0) return;
+	close(XferToolSock);
+	XferToolSock = -1;
+	if(XferToolUnix) unlink(XferToolSelf.sun_path);
+}
+
+/** Wait for the target */
+static void XferToolWait(void){
+
+	struct pollfd p;
+
+	if(XferToolIdle!=0){
+		XferToolIdle();
+	}else{
+		p.fd = XferToolSock;
+		p.events = POLLIN;
+		poll(&p,1,1);
+	}
+}
+
+/** Send one command frame, words high byte first */
+static void XferToolSend(unsigned int w0, unsigned int w1, unsigned int w2, unsigned int w3){
+
+	struct can_frame fr;
+	unsigned int w[4];
+	long waits = 0;
+	long n;
+	int i;
+
+	w[0] = w0; w[1] = w1; w[2] = w2; w[3] = w3;
+	memset(&fr,0,sizeof(fr));
+	fr.can_id = XFER_RX_ID;
+	fr.can_dlc = 8;
+	for(i=0;i<4;i++){
+		fr.data[2*i] = (unsigned char)(w[i]>>8);
+		fr.data[2*i+1] = (unsigned char)w[i];
+	}
+	// A full socket is waited out like a busy mailbox, in the end the frame
+	// is lost as on a bus and the timeouts recover
+	for(;;){
+		if(XferToolUnix){
+			n = sendto(XferToolSock,&fr,sizeof(fr),MSG_DONTWAIT,(struct sockaddr *)&XferToolPeer,sizeof(XferToolPeer));
+		}else{
+			n = send(XferToolSock,&fr,sizeof(fr),MSG_DONTWAIT);
+		}
+		if(n>=0 || (errno!=EAGAIN && errno!=EWOULDBLOCK && errno!=ENOBUFS)) return;
+		if(++waits>XferToolTimeout) return;
+		XferToolWait();
+	}
+}
+
+/** Take a waiting frame from the target, returns 1 when there was one */
+static int XferToolRecv(unsigned short *w){
+
+	struct can_frame fr;
+	int i;
+
+	for(;;){
+		if(recv(XferToolSock,&fr,sizeof(fr),MSG_DONTWAIT)!=(long)sizeof(fr)) return 0;
+		if((fr.can_id & CAN_SFF_MASK)!=XFER_TX_ID) continue;
+		for(i=0;i<4;i++){
+			w[i] = (unsigned short)((fr.data[2*i]<<8) | fr.data[2*i+1]);
+		}
+		return 1;
+	}
+}
+
+/** Stop any transfer and drain its frames, so a new start is not confused
+ *  with sequence numbers still on the way */
+static void XferToolQuiet(void){
+
+	unsigned short w[4];
+	int quiet = 0;
+
+	XferToolSend(XFER_STOP<<8,0,0,0);
+	while(quiet<XFER_TOOL_QUIET){
+		if(XferToolRecv(w)){
+			quiet = 0;
+		}else{
+			XferToolWait();
+			quiet++;
+		}
+	}
+}
+
+/** Read count words from offset within a region into dst, returns the
+ *  words read, short of count when the target stalls for good */
+long XferToolRead(int region, unsigned long offset, unsigned long count, unsigned short *dst){
+
+	unsigned short w[4];
+	unsigned long done = 0;
+	unsigned long at;
+	unsigned long n;
+	unsigned int frames;
+	unsigned int seq;
+	long waits;
+	int i;
+
+	if(XferToolSock<0) return -1;
+	XferToolRestarts = 0;
+	while(done<count){
+		n = (count-done>XFER_TOOL_CHUNK) ? XFER_TOOL_CHUNK : count-done;
+		frames = (unsigned int)((n+2)/3);
+		at = offset + done;
+		XferToolQuiet();
+		XferToolSend((XFER_START<<8) | (region & 0xFF), (at>>16) & 0xFFFF, at & 0xFFFF, (unsigned int)n);
+
+		seq = 0;
+		waits = 0;
+		while(seq<frames){
+			if(!XferToolRecv(w)){
+				XferToolWait();
+				if(++waits>XferToolTimeout) break;
+				continue;
+			}
+			// Replies and out of order frames are dropped, the target goes back
+			if(w[0]==XFER_REPLY || w[0]!=seq) continue;
+			if(XferToolDrop>0 && ++XferToolSeen%XferToolDrop==0){
+				XferToolDropped++;
+				continue;
+			}
+			XferToolFrames++;
+			for(i=0;i<3 && 3UL*seq+i<n;i++){
+				dst[done + 3UL*seq + i] = w[i+1];
+			}
+			seq++;
+			waits = 0;
+			if(seq%XferToolAckEvery==0 || seq==frames){
+				XferToolSend(XFER_ACK<<8,seq,0,0);
+			}
+		}
+		done += (3UL*seq<n) ? 3UL*seq : n;
+
+		// Stalled, resume from the first missing word
+		if(seq<frames && ++XferToolRestarts>XFER_TOOL_RESTARTS) break;
+	}
+	XferToolSend(XFER_STOP<<8,0,0,0);
+	return (long)done;
+}
+
+/** Long of two words, low word first */
+unsigned long XferToolLong(const unsigned short *w){
+
+	return (unsigned long)w[0] | ((unsigned long)w[1]<<16);
+}
+
+/** Signed long of two words, low word first */
+long XferToolSigned(const unsigned short *w){
+
+	unsigned long u = XferToolLong(w);
+
+	return (u & 0x80000000UL) ? -(long)(~u & 0x7FFFFFFFUL) - 1L : (long)u;
+}
+
+/** 64-bit tick of four words, low word first */
+unsigned long long XferToolTick(const unsigned short *w){
+
+	return (unsigned long long)XferToolLong(w) | ((unsigned long long)XferToolLong(w+2)<<32);
+}
+
+/** Float of two words, low word first */
+float XferToolFloat(const unsigned short *w){
+
+	unsigned long bits = XferToolLong(w);
+	unsigned int b32 = (unsigned int)bits;
+	float f;
+
+	memcpy(&f,&b32,sizeof(f));
+	return f;
+}
+
+/** Signed value of a target int */
+static int XferToolInt(const unsigned short *w){
+
+	return (int)(short)w[0];
+}
+
+/** Read and decode XFER_R_INDEX, returns 0 when read whole */
+int XferToolReadIndex(XferToolIndex *x){
+
+	unsigned short w[XFER_INDEX_WORDS];
+	const unsigned short *p = w;
+	int i;
+
+	if(XferToolRead(XFER_R_INDEX,0L,XFER_INDEX_WORDS,w)!=XFER_INDEX_WORDS) return -1;
+	x->EventIndex = XferToolInt(p); p += 1;
+	x->EventTotal = XferToolLong(p); p += 2;
+	x->EventVarHead = XferToolInt(p); p += 1;
+	x->EventVarTail = XferToolInt(p); p += 1;
+	x->EventVarSize = XferToolInt(p); p += 1;
+	x->LogLength = XferToolInt(p); p += 1;
+	x->LogCount = XferToolInt(p); p += 1;
+	x->LogHdrStart = XferToolTick(p); p += 4;
+	x->LogHdrSamples = XferToolLong(p); p += 2;
+	x->LogHdrPeriod = XferToolInt(p); p += 1;
+	x->LogHdrTrigger = XferToolInt(p); p += 1;
+	x->LogHdrTrigTick = XferToolTick(p); p += 4;
+	for(i=0;i<LOG_CHAN;i++,p+=2) x->LogHdrAddr[i] = XferToolSigned(p);
+	for(i=0;i<LOG_CHAN;i++,p+=1) x->LogHdrType[i] = XferToolInt(p);
+	x->LogMarkIndex = XferToolInt(p); p += 1;
+	for(i=0;i<LOG_MARKS;i++,p+=2) x->LogMarkSample[i] = XferToolLong(p);
+	for(i=0;i<LOG_MARKS;i++,p+=4) x->LogMarkTick[i] = XferToolTick(p);
+	for(i=0;i<LOG_MARKS;i++,p+=1) x->LogMarkPeriod[i] = XferToolInt(p);
+	return (p-w==XFER_INDEX_WORDS) ? 0 : -1;
+}
+
+/** Read the reply to an XFER_SET or XFER_GET of setting v, returns 0 when
+ *  answered, 1 when the target refused an XFER_SET, -1 on a timeout */
+static int XferToolReply(int v, long *value){
+
+	unsigned short w[4];
+	unsigned long u;
+	long waits = 0;
+
+	while(waits<=XferToolTimeout){
+		if(XferToolRecv(w)){
+			if(w[0]==XFER_REPLY && (w[1] & ~XFER_REJECT)==(unsigned short)v){
+				u = ((unsigned long)w[2]<<16) | w[3];
+				*value = (u & 0x80000000UL) ? -(long)(~u & 0x7FFFFFFFUL) - 1L : (long)u;
+				return (w[1] & XFER_REJECT) ? 1 : 0;
+			}
+			continue;
+		}
+		XferToolWait();
+		waits++;
+	}
+	return -1;
+}
+
+/** Write a setting, XFER_V_*, returns 0 when written, 1 when the target
+ *  refused the value as out of range */
+int XferToolSet(int v, long value){
+
+	long held;
+
+	if(XferToolSock<0) return -1;
+	XferToolSend((XFER_SET<<8) | (v & 0xFF), ((unsigned long)value>>16) & 0xFFFF, (unsigned long)value & 0xFFFF, 0);
+	return XferToolReply(v,&held);
+}
+
+/** Read a setting, XFER_V_*, returns 0 when answered */
+int XferToolGet(int v, long *value){
+
+	if(XferToolSock<0) return -1;
+	XferToolSend((XFER_GET<<8) | (v & 0xFF),0,0,0);
+	return (XferToolReply(v,value)==0) ? 0 : -1;
+}
+
+/** Reset the faults of the target */
+int XferToolReset(void){
+
+	if(XferToolSock<0) return -1;
+	XferToolSend(XFER_RESET<<8,0,0,0);
+	return 0;
+}
@@ -0,0 +1,52 @@
+/**
+ * @file XferTool.h
+ * @brief Host receiver of the windowed CAN block transfer, see LogXfer.c.
+ */
+
+#ifndef XFERTOOL_H_
+#define XFERTOOL_H_
+
+// Log positions and capture header from XFER_R_INDEX, the channel
+// addresses of a HOST_SIM target are byte offsets from its LogAddr0
+typedef struct {
+	int EventIndex;
+	unsigned long EventTotal;
+	int EventVarHead;
+	int EventVarTail;
+	int EventVarSize;
+	int LogLength;
+	int LogCount;
+	unsigned long long LogHdrStart;
+	unsigned long LogHdrSamples;
+	int LogHdrPeriod;
+	int LogHdrTrigger;
+	unsigned long long LogHdrTrigTick;
+	long LogHdrAddr[LOG_CHAN];
+	int LogHdrType[LOG_CHAN];
+	int LogMarkIndex;
+	unsigned long LogMarkSample[LOG_MARKS];
+	unsigned long long LogMarkTick[LOG_MARKS];
+	int LogMarkPeriod[LOG_MARKS];
+} XferToolIndex;
+
+extern void (*XferToolIdle)(void);
+extern long XferToolTimeout;
+extern int XferToolAckEvery;
+extern int XferToolDrop;
+extern unsigned long XferToolFrames;
+extern unsigned long XferToolDropped;
+extern int XferToolRestarts;
+
+int XferToolOpen(const char *name);
+void XferToolClose(void);
+long XferToolRead(int region, unsigned long offset, unsigned long count, unsigned short *dst);
+int XferToolReadIndex(XferToolIndex *x);
+int XferToolSet(int v, long value);
+int XferToolGet(int v, long *value);
+int XferToolReset(void);
+unsigned long XferToolLong(const unsigned short *w);
+long XferToolSigned(const unsigned short *w);
+unsigned long long XferToolTick(const unsigned short *w);
+float XferToolFloat(const unsigned short *w);
+
+#endif /* XFERTOOL_H_ */